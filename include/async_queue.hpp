@@ -9,19 +9,26 @@
 #ifndef ASYNC_QUEUE_HPP
 #define ASYNC_QUEUE_HPP
 
+#include <atomic>
 #include <condition_variable>
+#include <cstddef>              // size_t
+#include <cstdint>              // uint32_t
 #include <mutex>
 #include <optional>
 #include <queue>
+#include <stop_token>
+#include <type_traits>          // is_same_v<>
 #include <utility>              // forward(), move()
 
+#include "mpmc_ring.hpp"
+
 
 template<typename T,
          typename Q = std::queue<T>>
 class async_queue {
 
     std::mutex mutex;
-    std::condition_variable empty_cond;
+    std::condition_variable_any empty_cond;
     Q queue;
     bool should_stop = false;
 
@@ -90,6 +97,21 @@ public:
     }
 
 
+    // Like pop(), but also throws a stop_request{} when the token is stopped.
+    T
+    pop(std::stop_token token)
+    {
+        std::unique_lock guard{mutex};
+        if (!empty_cond.wait(guard, token, [this] { return should_stop || !queue.empty(); }))
+            throw stop_request{};
+        if (should_stop)
+            throw stop_request{};
+        T result = std::move(queue.front());
+        queue.pop();
+        return result;
+    }
+
+
     template<typename U>
     bool
     try_push(U&& x)
@@ -120,4 +142,158 @@ public:
 };
 
 
+/*
+ * Bounded, lock-free version: push() blocks while the ring is full.
+ *
+ * Instead of a condition variable, blocked threads wait on a version counter with
+ * atomic::wait(); every push, pop and stop bumps it. The counter is only notified when
+ * some thread is actually waiting.
+ */
+template<typename T,
+         std::size_t N>
+class async_queue<T, mpmc_ring<T, N>> {
+
+    mpmc_ring<T, N> ring;
+    std::atomic<bool> should_stop = false;
+
+    alignas(64) std::atomic<std::uint32_t> version = 0;
+    std::atomic<unsigned> num_waiters = 0;
+
+
+    void
+    bump()
+    {
+        version.fetch_add(1);
+        if (num_waiters.load())
+            version.notify_all();
+    }
+
+
+    // Retry op() until it succeeds, or pred() stops the wait.
+    template<typename Op,
+             typename Pred>
+    auto
+    wait_until_done(Op op,
+                    Pred should_abort)
+    {
+        for (;;) {
+            ++num_waiters;
+            std::uint32_t v = version.load();
+            if (should_abort()) {
+                --num_waiters;
+                throw stop_request{};
+            }
+            if (auto result = op()) {
+                --num_waiters;
+                return result;
+            }
+            version.wait(v);
+            --num_waiters;
+        }
+    }
+
+public:
+
+    struct stop_request {};
+
+    // Makes the queue usable again after a stop().
+    void
+    reset()
+    {
+        should_stop = false;
+    }
+
+
+    // This will make all future pop() calls throw a stop_request{}.
+    // It also wakes up all waiting threads.
+    void
+    stop()
+    {
+        should_stop = true;
+        bump();
+    }
+
+
+    bool
+    is_stopping()
+        const
+    {
+        return should_stop;
+    }
+
+
+    bool
+    empty()
+        const
+    {
+        return ring.empty();
+    }
+
+
+    // Throws stop_request{} if the queue is stopped while waiting for a free slot.
+    template<typename U>
+    void
+    push(U&& x)
+    {
+        T item(std::forward<U>(x));
+        wait_until_done([&] { return ring.try_push(std::move(item)); },
+                        [this] { return should_stop.load(); });
+        bump();
+    }
+
+
+    T
+    pop()
+    {
+        auto result = wait_until_done([this] { return ring.try_pop(); },
+                                      [this] { return should_stop.load(); });
+        bump();
+        return std::move(*result);
+    }
+
+
+    // Like pop(), but also throws a stop_request{} when the token is stopped.
+    T
+    pop(std::stop_token token)
+    {
+        std::stop_callback wake{token, [this] { bump(); }};
+        auto result = wait_until_done([this] { return ring.try_pop(); },
+                                      [&] { return should_stop || token.stop_requested(); });
+        bump();
+        return std::move(*result);
+    }
+
+
+    // Never blocks; fails only if the ring is full. A T rvalue is left intact on failure.
+    template<typename U>
+    bool
+    try_push(U&& x)
+    {
+        bool pushed;
+        if constexpr (std::is_same_v<U, T>)
+            pushed = ring.try_push(std::move(x));
+        else {
+            T item(std::forward<U>(x));
+            pushed = ring.try_push(std::move(item));
+        }
+        if (pushed)
+            bump();
+        return pushed;
+    }
+
+
+    std::optional<T>
+    try_pop()
+    {
+        if (should_stop && !ring.empty())
+            throw stop_request{};
+        auto result = ring.try_pop();
+        if (result)
+            bump();
+        return result;
+    }
+
+};
+
+
 #endif
@@ -18,8 +18,11 @@
 namespace cfg {
 
     extern wups::option<bool>                      auto_tz;
+    extern wups::option<int>                       burst;
     extern wups::option<std::chrono::seconds>      msg_duration;
     extern wups::option<int>                       notify;
+    extern wups::option<bool>                      periodic;
+    extern wups::option<int>                       quorum;
     extern wups::option<std::string>               server;
     extern wups::option<bool>                      sync_on_boot;
     extern wups::option<bool>                      sync_on_changes;
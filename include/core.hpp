@@ -9,12 +9,16 @@
 #ifndef CORE_HPP
 #define CORE_HPP
 
+#include <stdexcept>            // runtime_error
 #include <stop_token>
 #include <string>
-#include <utility>              // pair<>
 
+#include "coro.hpp"
 #include "net/address.hpp"
+#include "net/reactor.hpp"
+#include "ntp.hpp"
 #include "time_utils.hpp"
+#include "utc.hpp"
 
 
 namespace core {
@@ -22,12 +26,45 @@ namespace core {
     using time_utils::dbl_seconds;
 
 
-    std::pair<dbl_seconds, dbl_seconds>
-    ntp_query(std::stop_token token,
-              net::address address);
+    struct canceled_error : std::runtime_error {
+        canceled_error();
+    };
 
 
+    // Throws canceled_error if a stop was requested.
     void
+    check_stop(std::stop_token token);
+
+
+    // Samples one server, using a burst of cfg::burst requests.
+    coro::task<ntp::clock_filter>
+    ntp_query(net::reactor& reactor,
+              net::address address);
+
+
+    // Timing of the last clock change.
+    struct apply_stats {
+        bool success = false;
+        dbl_seconds ccr_duration{0};   // CCRSysSetSystemTime()
+        dbl_seconds abs_duration{0};   // __OSSetAbsoluteSystemTime()
+        dbl_seconds total_duration{0}; // including the PDM notifications
+        // How far the clock may still be off, due to the time spent inside the calls.
+        dbl_seconds residual{0};
+    };
+
+
+    /*
+     * Set the clock, so it matches `local + correction` at the anchor. Both system calls
+     * write the same target instant, projected forward by the ticks elapsed since the
+     * anchor.
+     */
+    apply_stats
+    apply_clock_correction(dbl_seconds correction,
+                           utc::clock_anchor anchor);
+
+
+    // Returns the combined result from all servers, even if the clock was not changed.
+    ntp::selection
     run(std::stop_token token,
         bool silent);
 
@@ -0,0 +1,259 @@
+/*
+ * Wii U Time Sync - A NTP client plugin for the Wii U.
+ *
+ * Copyright (C) 2025  Daniel K. O.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef CORO_HPP
+#define CORO_HPP
+
+#include <coroutine>
+#include <exception>            // current_exception(), exception_ptr, rethrow_exception()
+#include <optional>
+#include <utility>              // exchange(), forward(), move()
+
+
+// Minimal coroutine support, to be driven by net::reactor.
+
+namespace coro {
+
+    template<typename T>
+    class task;
+
+
+    namespace detail {
+
+        struct promise_base {
+
+            std::coroutine_handle<> continuation = std::noop_coroutine();
+            std::exception_ptr error;
+
+
+            // Tasks are lazy, they only start when awaited, or started by the reactor.
+            std::suspend_always
+            initial_suspend()
+                noexcept
+            { return {}; }
+
+
+            // When finished, resume whoever is awaiting this task.
+            struct final_awaiter {
+
+                bool
+                await_ready()
+                    noexcept
+                { return false; }
+
+                template<typename P>
+                std::coroutine_handle<>
+                await_suspend(std::coroutine_handle<P> h)
+                    noexcept
+                { return h.promise().continuation; }
+
+                void
+                await_resume()
+                    noexcept
+                {}
+
+            };
+
+            final_awaiter
+            final_suspend()
+                noexcept
+            { return {}; }
+
+
+            void
+            unhandled_exception()
+                noexcept
+            { error = std::current_exception(); }
+
+
+            void
+            rethrow_if_error()
+            {
+                if (error)
+                    std::rethrow_exception(error);
+            }
+
+        };
+
+
+        template<typename T>
+        struct promise : promise_base {
+
+            std::optional<T> value;
+
+            task<T> get_return_object() noexcept;
+
+            template<typename U>
+            void
+            return_value(U&& v)
+            { value.emplace(std::forward<U>(v)); }
+
+            T
+            result()
+            {
+                rethrow_if_error();
+                return std::move(*value);
+            }
+
+        };
+
+
+        template<>
+        struct promise<void> : promise_base {
+
+            task<void> get_return_object() noexcept;
+
+            void
+            return_void()
+                noexcept
+            {}
+
+            void
+            result()
+            { rethrow_if_error(); }
+
+        };
+
+    } // namespace detail
+
+
+    /*
+     * A lazy coroutine that produces a T. Awaiting it from another coroutine starts it,
+     * and resumes the awaiting coroutine when it finishes. Destroying a task destroys its
+     * coroutine frame, even if it's suspended.
+     */
+    template<typename T = void>
+    class task {
+
+    public:
+
+        using promise_type = detail::promise<T>;
+        using handle_type = std::coroutine_handle<promise_type>;
+
+    private:
+
+        handle_type handle;
+
+    public:
+
+        task() noexcept = default;
+
+
+        explicit
+        task(handle_type h)
+            noexcept :
+            handle{h}
+        {}
+
+
+        task(task&& other)
+            noexcept :
+            handle{std::exchange(other.handle, nullptr)}
+        {}
+
+
+        task&
+        operator =(task&& other)
+            noexcept
+        {
+            if (this != &other) {
+                if (handle)
+                    handle.destroy();
+                handle = std::exchange(other.handle, nullptr);
+            }
+            return *this;
+        }
+
+
+        ~task()
+        {
+            if (handle)
+                handle.destroy();
+        }
+
+
+        bool
+        done()
+            const noexcept
+        {
+            return !handle || handle.done();
+        }
+
+
+        // Run the coroutine until its first suspension point.
+        void
+        start()
+        {
+            handle.resume();
+        }
+
+
+        // Only valid after done() returns true; rethrows the coroutine's exception.
+        T
+        result()
+        {
+            return handle.promise().result();
+        }
+
+
+        auto
+        operator co_await()
+            && noexcept
+        {
+            struct awaiter {
+
+                handle_type handle;
+
+                bool
+                await_ready()
+                    noexcept
+                { return !handle || handle.done(); }
+
+                std::coroutine_handle<>
+                await_suspend(std::coroutine_handle<> awaiting)
+                    noexcept
+                {
+                    handle.promise().continuation = awaiting;
+                    return handle;
+                }
+
+                T
+                await_resume()
+                { return handle.promise().result(); }
+
+            };
+            return awaiter{handle};
+        }
+
+    };
+
+
+    namespace detail {
+
+        template<typename T>
+        task<T>
+        promise<T>::get_return_object()
+            noexcept
+        {
+            return task<T>{std::coroutine_handle<promise<T>>::from_promise(*this)};
+        }
+
+
+        inline
+        task<void>
+        promise<void>::get_return_object()
+            noexcept
+        {
+            return task<void>{std::coroutine_handle<promise<void>>::from_promise(*this)};
+        }
+
+    } // namespace detail
+
+} // namespace coro
+
+#endif
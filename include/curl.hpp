@@ -9,6 +9,7 @@
 #ifndef CURL_HPP
 #define CURL_HPP
 
+#include <chrono>
 #include <memory>
 #include <stdexcept>            // runtime_error
 #include <string>
@@ -67,12 +68,14 @@ namespace curl {
 
 
         void setopt(CURLoption option, bool arg);
+        void setopt(CURLoption option, long arg);
         void setopt(CURLoption option, const std::string& arg);
 
 
         // convenience setters
 
         void set_followlocation(bool enable);
+        void set_timeout(std::chrono::milliseconds timeout);
         void set_url(const std::string& url);
         void set_useragent(const std::string& agent);
 
@@ -0,0 +1,113 @@
+/*
+ * Wii U Time Sync - A NTP client plugin for the Wii U.
+ *
+ * Copyright (C) 2025  Daniel K. O.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef DNS_CACHE_HPP
+#define DNS_CACHE_HPP
+
+#include <chrono>
+#include <cstddef>              // size_t
+#include <functional>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "coro.hpp"
+#include "net/addrinfo.hpp"
+#include "net/reactor.hpp"
+
+
+/*
+ * Cache for net::addrinfo::lookup(), keyed by (name, service, hints). The last good
+ * answers are stored along with the configuration, so a sync at boot can use them right
+ * away, while they're refreshed in the background.
+ */
+
+namespace dns_cache {
+
+    using net::addrinfo::hints;
+    using net::addrinfo::result;
+
+
+    // How long answers are trusted; getaddrinfo() doesn't report the record's TTL.
+    constexpr std::chrono::seconds default_ttl{5 * 60};
+
+    // Expired answers are still used up to this age, while a refresh is done.
+    constexpr std::chrono::seconds max_stale{7 * 24 * 60 * 60};
+
+
+    struct entry {
+        std::vector<result> results;
+        bool expired;
+    };
+
+
+    // Load the cache from storage.
+    void load() noexcept;
+
+
+    // Returns nothing if the name is not cached, or the answer is too old.
+    std::optional<entry>
+    find(const std::string& name,
+         const std::string& service,
+         const hints& opts);
+
+
+    // Resolve the name, and cache the answer. Errors are thrown, like in lookup().
+    std::vector<result>
+    refresh(const std::string& name,
+            const std::string& service,
+            const hints& opts);
+
+
+    // How many names net::resolver is asked about at the same time.
+    constexpr std::size_t max_in_flight = 8;
+
+
+    using answer_callback =
+        std::function<void (const std::string& name,
+                            const std::optional<std::vector<result>>& answer)>;
+
+
+    /*
+     * Resolve the names with net::resolver, through the console's DNS servers, and cache
+     * the answers with their TTLs. Names it couldn't resolve are returned empty, so they
+     * can be tried with refresh() instead.
+     *
+     * Each answer is also passed to `on_answer` as soon as it arrives.
+     */
+    coro::task<std::vector<std::optional<std::vector<result>>>>
+    resolve(net::reactor& reactor,
+            std::vector<std::string> names,
+            std::string service,
+            hints opts,
+            std::chrono::milliseconds timeout,
+            answer_callback on_answer = {});
+
+
+    // The cached answer, if it's not expired; otherwise, refresh().
+    std::vector<result>
+    lookup(const std::string& name,
+           const std::string& service,
+           const hints& opts);
+
+
+    // Add an answer obtained elsewhere; it's only saved by store().
+    void
+    insert(const std::string& name,
+           const std::string& service,
+           const hints& opts,
+           const std::vector<result>& results,
+           std::chrono::seconds ttl = default_ttl);
+
+
+    // Save the answers added since the last call, if any; done once per sync.
+    void store();
+
+} // namespace dns_cache
+
+#endif
@@ -0,0 +1,55 @@
+/*
+ * Wii U Time Sync - A NTP client plugin for the Wii U.
+ *
+ * Copyright (C) 2025  Daniel K. O.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef DRIFT_HPP
+#define DRIFT_HPP
+
+#include <optional>
+
+#include "time_utils.hpp"
+
+
+/*
+ * Frequency error estimator for the console's clock, in the style of a FLL (frequency
+ * locked loop). It's fed with the corrections found by each sync, and is stored along
+ * with the configuration, so it survives reboots.
+ */
+
+namespace drift {
+
+    using time_utils::dbl_seconds;
+
+
+    struct prediction {
+        dbl_seconds offset; // expected correction, right now
+        dbl_seconds error;  // how wrong that expectation might be
+    };
+
+
+    // Load the estimator from storage.
+    void load() noexcept;
+
+
+    // Returns nothing until the estimator has seen enough syncs.
+    std::optional<prediction> predict();
+
+
+    /*
+     * Feed the correction measured by a sync. If `corrected` is true, the clock was set,
+     * so the clock has no offset left.
+     */
+    void update(dbl_seconds measured,
+                bool corrected);
+
+
+    // Frequency error, in parts per million. Positive means the clock is running slow.
+    double ppm() noexcept;
+
+} // namespace drift
+
+#endif
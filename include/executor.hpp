@@ -0,0 +1,63 @@
+/*
+ * Wii U Time Sync - A NTP client plugin for the Wii U.
+ *
+ * Copyright (C) 2025  Daniel K. O.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef EXECUTOR_HPP
+#define EXECUTOR_HPP
+
+#include <utility>              // forward()
+
+#include "thread_pool.hpp"
+
+
+/*
+ * The plugin-wide thread pool. All asynchronous work goes through here, so threads are
+ * only created once, not once per sync.
+ */
+
+namespace executor {
+
+    // Create the pool, sized from cfg::threads.
+    void initialize();
+
+    void finalize();
+
+
+    // Apply a change to cfg::threads.
+    void update_size();
+
+
+    // Stop all worker threads, so none of them runs into the next application; workers
+    // that don't stop within a second are detached.
+    void release_workers();
+
+
+    // Throws std::logic_error if the executor is not initialized.
+    thread_pool& get();
+
+
+    template<typename Func, typename... Args>
+    auto
+    submit(Func&& func, Args&&... args)
+    {
+        return get().submit(std::forward<Func>(func),
+                            std::forward<Args>(args)...);
+    }
+
+
+    // Never runs the task on the calling thread, see thread_pool::enqueue().
+    template<typename Func, typename... Args>
+    auto
+    enqueue(Func&& func, Args&&... args)
+    {
+        return get().enqueue(std::forward<Func>(func),
+                             std::forward<Args>(args)...);
+    }
+
+} // namespace executor
+
+#endif
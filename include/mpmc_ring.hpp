@@ -0,0 +1,144 @@
+/*
+ * Wii U Time Sync - A NTP client plugin for the Wii U.
+ *
+ * Copyright (C) 2025  Daniel K. O.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef MPMC_RING_HPP
+#define MPMC_RING_HPP
+
+#include <atomic>
+#include <cstddef>              // byte, size_t
+#include <cstdint>              // intptr_t
+#include <new>                  // launder()
+#include <optional>
+#include <type_traits>          // is_nothrow_move_constructible_v<>
+#include <utility>              // move()
+
+
+/*
+ * Bounded lock-free multi-producer/multi-consumer queue, as described by Dmitry Vyukov.
+ *
+ * Each cell has a sequence number that tells whether it's ready to be written to or read
+ * from, for the current lap around the ring; producers and consumers only contend on the
+ * head and tail counters, which are in separate cache lines.
+ *
+ * Use it through async_queue<T, mpmc_ring<T, N>> to get blocking operations.
+ */
+template<typename T,
+         std::size_t N>
+class mpmc_ring {
+
+    static_assert(N >= 2 && (N & (N - 1)) == 0, "N must be a power of 2");
+    static_assert(std::is_nothrow_move_constructible_v<T>);
+
+    struct alignas(64) cell {
+        std::atomic<std::size_t> seq;
+        alignas(T) std::byte storage[sizeof(T)];
+
+        T*
+        get()
+            noexcept
+        {
+            return std::launder(reinterpret_cast<T*>(storage));
+        }
+    };
+
+    cell cells[N];
+
+    alignas(64) std::atomic<std::size_t> head = 0; // next position to push
+    alignas(64) std::atomic<std::size_t> tail = 0; // next position to pop
+
+public:
+
+    mpmc_ring()
+        noexcept
+    {
+        for (std::size_t i = 0; i < N; ++i)
+            cells[i].seq.store(i, std::memory_order_relaxed);
+    }
+
+
+    mpmc_ring(const mpmc_ring&) = delete;
+
+
+    ~mpmc_ring()
+    {
+        while (try_pop())
+            ;
+    }
+
+
+    static constexpr
+    std::size_t
+    capacity()
+        noexcept
+    {
+        return N;
+    }
+
+
+    // Returns false if full; x is only moved from if this returns true.
+    bool
+    try_push(T&& x)
+        noexcept
+    {
+        cell* c;
+        std::size_t pos = head.load(std::memory_order_relaxed);
+        for (;;) {
+            c = &cells[pos & (N - 1)];
+            std::size_t seq = c->seq.load(std::memory_order_acquire);
+            auto dif = static_cast<std::intptr_t>(seq) - static_cast<std::intptr_t>(pos);
+            if (dif == 0) {
+                if (head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            } else if (dif < 0)
+                return false;
+            else
+                pos = head.load(std::memory_order_relaxed);
+        }
+        new (c->storage) T(std::move(x));
+        c->seq.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+
+    // Returns nothing if empty.
+    std::optional<T>
+    try_pop()
+        noexcept
+    {
+        cell* c;
+        std::size_t pos = tail.load(std::memory_order_relaxed);
+        for (;;) {
+            c = &cells[pos & (N - 1)];
+            std::size_t seq = c->seq.load(std::memory_order_acquire);
+            auto dif = static_cast<std::intptr_t>(seq) - static_cast<std::intptr_t>(pos + 1);
+            if (dif == 0) {
+                if (tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            } else if (dif < 0)
+                return {};
+            else
+                pos = tail.load(std::memory_order_relaxed);
+        }
+        std::optional<T> result{std::move(*c->get())};
+        c->get()->~T();
+        c->seq.store(pos + N, std::memory_order_release);
+        return result;
+    }
+
+
+    // Only a hint, if other threads are using the ring.
+    bool
+    empty()
+        const noexcept
+    {
+        return head.load(std::memory_order_acquire) == tail.load(std::memory_order_acquire);
+    }
+
+};
+
+#endif
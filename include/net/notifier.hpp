@@ -0,0 +1,56 @@
+/*
+ * Wii U Time Sync - A NTP client plugin for the Wii U.
+ *
+ * Copyright (C) 2025  Daniel K. O.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef NET_NOTIFIER_HPP
+#define NET_NOTIFIER_HPP
+
+#include <atomic>
+
+#include "coro.hpp"
+#include "net/address.hpp"
+#include "net/reactor.hpp"
+#include "net/socket.hpp"
+
+
+namespace net {
+
+    /*
+     * Lets other threads wake up a coroutine on the reactor, which otherwise only wakes
+     * up for its sockets and deadlines. It's a loopback UDP socket: notify() sends it a
+     * datagram, and wait() waits for it to be readable.
+     *
+     * Keep it in a shared_ptr when other threads may notify it after the waiter is gone.
+     */
+    class notifier {
+
+        socket sock;
+        address addr;
+        std::atomic<bool> pending = false;
+
+    public:
+
+        // Throws net::error if the loopback socket can't be created.
+        notifier();
+
+
+        // Thread-safe, and never blocks. Notifications before a wait() are not lost.
+        void
+        notify()
+            noexcept;
+
+
+        // Suspends until notified, or the deadline; returns false if the deadline came first.
+        coro::task<bool>
+        wait(reactor& r,
+             reactor::clock::time_point deadline);
+
+    };
+
+} // namespace net
+
+#endif
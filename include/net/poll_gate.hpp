@@ -0,0 +1,55 @@
+/*
+ * Wii U Time Sync - A NTP client plugin for the Wii U.
+ *
+ * Copyright (C) 2025  Daniel K. O.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef NET_POLL_GATE_HPP
+#define NET_POLL_GATE_HPP
+
+#include <chrono>
+#include <cstddef>              // ptrdiff_t
+#include <cstdint>
+
+#include <poll.h>
+
+
+/*
+ * The Wii U fails poll() with ENOMEM when more than 16 threads are polling at the same
+ * time. Every poll() in the plugin goes through here, so instead of failing, callers wait
+ * for a free slot.
+ */
+
+namespace net::poll_gate {
+
+    constexpr std::ptrdiff_t max_slots = 16;
+
+
+    struct stats {
+        std::uint32_t polls = 0;    // poll() calls made
+        std::uint32_t waits = 0;    // calls that found no free slot, and had to wait
+        std::uint32_t timeouts = 0; // calls that never got a slot before the timeout
+        std::uint32_t enomem = 0;   // calls rejected by the OS anyway (other processes)
+    };
+
+
+    /*
+     * Same as ::poll(), but waits for a free slot first. Waiting counts against the
+     * timeout; if no slot frees up in time, it returns 0, as if nothing happened.
+     */
+    int
+    poll(pollfd* fds,
+         nfds_t count,
+         std::chrono::milliseconds timeout)
+        noexcept;
+
+
+    stats
+    get_stats()
+        noexcept;
+
+} // namespace net::poll_gate
+
+#endif
@@ -0,0 +1,75 @@
+/*
+ * Wii U Time Sync - A NTP client plugin for the Wii U.
+ *
+ * Copyright (C) 2025  Daniel K. O.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef NET_POLLER_HPP
+#define NET_POLLER_HPP
+
+#include <chrono>
+#include <cstddef>              // size_t
+#include <expected>
+#include <vector>
+
+#include <poll.h>
+
+#include "net/error.hpp"
+#include "net/socket.hpp"
+
+
+namespace net {
+
+    /*
+     * Waits on many sockets with a single poll() call, so they all share one poll slot.
+     * Sockets are identified by the order they were added in.
+     */
+    class poller {
+
+    public:
+
+        using poll_flags = socket::poll_flags;
+
+
+        struct ready {
+            std::size_t index;  // the order in which the socket was added
+            poll_flags  events;
+        };
+
+
+        // Returns the index of the socket.
+        std::size_t
+        add(const socket& s,
+            poll_flags events);
+
+        void clear() noexcept;
+
+        bool empty() const noexcept;
+
+        std::size_t size() const noexcept;
+
+
+        // Block until at least one socket is ready.
+        std::vector<ready> wait();
+
+        // Returns an empty set if the timeout is reached.
+        std::vector<ready> wait(std::chrono::milliseconds timeout);
+
+
+        std::expected<std::vector<ready>, error> try_wait() noexcept;
+
+        std::expected<std::vector<ready>, error>
+        try_wait(std::chrono::milliseconds timeout)
+            noexcept;
+
+    private:
+
+        std::vector<pollfd> fds;
+
+    };
+
+} // namespace net
+
+#endif
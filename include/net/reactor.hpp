@@ -0,0 +1,160 @@
+/*
+ * Wii U Time Sync - A NTP client plugin for the Wii U.
+ *
+ * Copyright (C) 2025  Daniel K. O.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef NET_REACTOR_HPP
+#define NET_REACTOR_HPP
+
+#include <chrono>
+#include <coroutine>
+#include <cstddef>              // size_t
+#include <optional>
+#include <stop_token>
+#include <type_traits>          // is_void_v<>
+#include <utility>              // move(), pair<>
+#include <vector>
+
+#include "coro.hpp"
+#include "net/address.hpp"
+#include "net/poller.hpp"
+#include "net/socket.hpp"
+
+
+namespace net {
+
+    /*
+     * Single-threaded event loop for coroutines. Every suspended coroutine waits for a
+     * socket event, a deadline, or both; each round, all the sockets are watched by one
+     * net::poller, so the whole reactor uses a single poll slot.
+     *
+     * Cancellation: poll() can't be interrupted, so while sockets are watched the stop token
+     * is checked at least every `max_wait`; pure timers wake up as soon as it's stopped.
+     * Once stopped, run() destroys all coroutines.
+     */
+    class reactor {
+
+    public:
+
+        using clock = std::chrono::steady_clock;
+
+        static constexpr std::chrono::milliseconds max_wait{100};
+
+
+        class wait_op {
+
+            friend class reactor;
+
+            reactor& owner;
+            const socket* sock;            // null for a pure timer
+            socket::poll_flags events;
+            clock::time_point deadline;
+            socket::poll_flags revents = socket::poll_flags::none;
+            std::coroutine_handle<> handle;
+
+        public:
+
+            wait_op(reactor& owner,
+                    const socket* sock,
+                    socket::poll_flags events,
+                    clock::time_point deadline)
+                noexcept;
+
+            bool await_ready() const noexcept;
+
+            void await_suspend(std::coroutine_handle<> h);
+
+            // The events that happened; none if the deadline was reached.
+            socket::poll_flags await_resume() const noexcept;
+
+        };
+
+
+        reactor() = default;
+
+        reactor(const reactor&) = delete;
+
+
+        // Suspends until one of the events happen in the socket, or the deadline.
+        wait_op
+        wait(const socket& s,
+             socket::poll_flags events,
+             clock::time_point deadline)
+            noexcept;
+
+
+        wait_op
+        sleep_until(clock::time_point deadline)
+            noexcept;
+
+
+        // Make a pending wait finish on the next round, as if its deadline was reached.
+        void
+        wake(wait_op& op)
+            noexcept;
+
+
+        /*
+         * Non-blocking datagram operations: they suspend until the socket is ready, and
+         * return nothing if the deadline is reached first. Other errors are thrown.
+         */
+        coro::task<std::optional<std::size_t>>
+        sendto(socket& s,
+               const void* buf,
+               std::size_t len,
+               address dst,
+               clock::time_point deadline);
+
+        coro::task<std::optional<std::pair<std::size_t, address>>>
+        recvfrom(socket& s,
+                 void* buf,
+                 std::size_t len,
+                 clock::time_point deadline);
+
+
+        // Run a task concurrently with the others; the reactor owns it until it finishes.
+        void
+        spawn(coro::task<void> t);
+
+
+        /*
+         * Start the task, and run the event loop until it finishes. Returns nothing if the
+         * token was stopped; exceptions from the task are rethrown.
+         */
+        template<typename T>
+        std::optional<T>
+        run(std::stop_token token,
+            coro::task<T> root)
+        {
+            static_assert(!std::is_void_v<T>);
+            root.start();
+            while (!root.done()) {
+                if (token.stop_requested()) {
+                    cancel();
+                    return {};
+                }
+                step(token);
+            }
+            spawned.clear();
+            waiting.clear();
+            return root.result();
+        }
+
+    private:
+
+        std::vector<wait_op*> waiting;
+        std::vector<coro::task<void>> spawned;
+
+        // One round: wait for events or deadlines, then resume whoever is done waiting.
+        void step(std::stop_token token);
+
+        void cancel() noexcept;
+
+    };
+
+} // namespace net
+
+#endif
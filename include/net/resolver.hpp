@@ -0,0 +1,113 @@
+/*
+ * Wii U Time Sync - A NTP client plugin for the Wii U.
+ *
+ * Copyright (C) 2025  Daniel K. O.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef NET_RESOLVER_HPP
+#define NET_RESOLVER_HPP
+
+#include <chrono>
+#include <cstddef>              // size_t
+#include <cstdint>
+#include <expected>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "coro.hpp"
+#include "net/address.hpp"
+#include "net/reactor.hpp"
+#include "net/socket.hpp"
+
+
+namespace net {
+
+    /*
+     * Minimal DNS stub resolver, for A records only. All the names are queried through a
+     * single UDP socket, and the replies are matched by their random query ID and their
+     * question; unanswered queries are sent again, rotating through the servers.
+     *
+     * Anything unusual (truncated replies, no A records, etc) is reported as an error, so
+     * the caller can fall back to net::addrinfo::lookup().
+     */
+    class resolver {
+
+    public:
+
+        using clock = std::chrono::steady_clock;
+
+
+        struct answer {
+            std::vector<ipv4_t> addresses;
+            std::chrono::seconds ttl; // the smallest TTL among the records
+        };
+
+        using outcome = std::expected<answer, std::string>;
+
+
+        explicit
+        resolver(std::vector<address> servers);
+
+
+        // Schedule a query; returns its index in the results.
+        std::size_t
+        add(const std::string& name);
+
+
+        // Limit how many queries wait for replies at the same time; zero means no limit.
+        void
+        set_max_in_flight(std::size_t n)
+            noexcept;
+
+
+        // Called as soon as each query is done, with its index, before run() returns.
+        void
+        set_callback(std::function<void (std::size_t, const outcome&)> callback);
+
+
+        /*
+         * Send all queries, and wait up to `timeout` for their replies. Queries are sent
+         * again every `retransmit` until they're answered.
+         */
+        coro::task<std::vector<outcome>>
+        run(reactor& r,
+            std::chrono::milliseconds timeout,
+            std::chrono::milliseconds retransmit = std::chrono::seconds{1});
+
+    private:
+
+        struct query {
+            std::string name;
+            std::uint16_t id;
+            unsigned attempts = 0;
+            clock::time_point next_send;
+            bool done = false;
+            outcome result;
+        };
+
+
+        std::vector<address> servers;
+
+        std::vector<query> queries;
+
+        std::size_t max_in_flight = 0;
+
+        std::function<void (std::size_t, const outcome&)> on_result;
+
+        socket sock;
+
+
+        void send(query& q, std::chrono::milliseconds retransmit);
+
+        void drain();
+
+        void complete(query& q, outcome result);
+
+    };
+
+} // namespace net
+
+#endif
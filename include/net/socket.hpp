@@ -12,6 +12,7 @@
 #include <chrono>
 #include <cstdint>
 #include <expected>
+#include <span>
 #include <utility>              // pair<>
 
 #include <netinet/in.h>         // IP_*
@@ -105,6 +106,35 @@ namespace net {
         };
 
 
+        /*
+         * Descriptors for the batch operations. Each one reports its own outcome; `ticks`
+         * is the system time (OSGetSystemTime()) right before the datagram was sent, or
+         * right after it was received.
+         *
+         * Note: with the real sendmmsg() (only on Linux), all datagrams in a batch share
+         * the time taken right before the call; received datagrams use the kernel's
+         * arrival time.
+         */
+
+        struct outgoing {
+            const void*  buf = nullptr;
+            std::size_t  len = 0;
+            address      dst;
+            std::size_t  size = 0;  // bytes sent
+            int          error = 0; // errno, if this datagram failed
+            std::int64_t ticks = 0;
+        };
+
+        struct incoming {
+            void*        buf = nullptr;
+            std::size_t  len = 0;
+            address      src;
+            std::size_t  size = 0;  // bytes received
+            int          error = 0; // errno, if this datagram failed
+            std::int64_t ticks = 0;
+        };
+
+
         constexpr
         socket() noexcept = default;
 
@@ -228,10 +258,21 @@ namespace net {
         recvfrom(void* buf, std::size_t len,
                  msg_flags flags = msg_flags::none);
 
+        /*
+         * Batch operations: they stop at the first datagram that fails, and return how
+         * many succeeded. Only when the first one fails it's reported as an error.
+         */
+        std::size_t
+        recvmmsg(std::span<incoming> msgs,
+                 msg_flags flags = msg_flags::none);
+
 
         // Disassociate the handle from this socket.
         int release() noexcept;
 
+        // The handle, without releasing it; for poll().
+        int native_handle() const noexcept;
+
 
         std::size_t
         send(const void* buf, std::size_t len,
@@ -241,6 +282,10 @@ namespace net {
         send_all(const void* buf, std::size_t total,
                  msg_flags flags = msg_flags::none);
 
+        std::size_t
+        sendmmsg(std::span<outgoing> msgs,
+                 msg_flags flags = msg_flags::none);
+
         std::size_t
         sendto(const void* buf, std::size_t len,
                address dst,
@@ -315,12 +360,22 @@ namespace net {
                      msg_flags flags = msg_flags::none)
             noexcept;
 
+        std::expected<std::size_t, error>
+        try_recvmmsg(std::span<incoming> msgs,
+                     msg_flags flags = msg_flags::none)
+            noexcept;
+
 
         std::expected<std::size_t, error>
         try_send(const void* buf, std::size_t len,
                  msg_flags flags = msg_flags::none)
             noexcept;
 
+        std::expected<std::size_t, error>
+        try_sendmmsg(std::span<outgoing> msgs,
+                     msg_flags flags = msg_flags::none)
+            noexcept;
+
         std::expected<std::size_t, error>
         try_sendto(const void* buf, std::size_t len,
                    address dst,
@@ -9,9 +9,13 @@
 #ifndef NTP_HPP
 #define NTP_HPP
 
+#include <bit>                  // byteswap(), endian
 #include <compare>
+#include <cstddef>              // size_t
 #include <cstdint>
+#include <stdexcept>            // overflow_error
 #include <string>
+#include <vector>
 
 #include "time_utils.hpp"
 
@@ -23,6 +27,84 @@ namespace ntp {
     using time_utils::dbl_seconds;
 
 
+    // This is a signed s32.32 fixed-point format, for differences between timestamps.
+    class duration {
+
+        std::int64_t raw = 0;
+
+    public:
+
+        constexpr duration() noexcept = default;
+
+        // The argument is in units of 2^-32 seconds.
+        static constexpr
+        duration
+        from_raw(std::int64_t r)
+            noexcept
+        {
+            duration result;
+            result.raw = r;
+            return result;
+        }
+
+        constexpr
+        std::int64_t
+        raw_value()
+            const noexcept
+        { return raw; }
+
+
+        // Note: conversion to floating-point should be done only at the end.
+        explicit operator dbl_seconds() const noexcept;
+
+
+        // These throw std::overflow_error if the result is not representable.
+        constexpr
+        duration
+        operator +(duration other)
+            const
+        {
+            std::int64_t result;
+            if (__builtin_add_overflow(raw, other.raw, &result))
+                throw std::overflow_error{"ntp::duration overflow in addition"};
+            return from_raw(result);
+        }
+
+        constexpr
+        duration
+        operator -(duration other)
+            const
+        {
+            std::int64_t result;
+            if (__builtin_sub_overflow(raw, other.raw, &result))
+                throw std::overflow_error{"ntp::duration overflow in subtraction"};
+            return from_raw(result);
+        }
+
+        constexpr
+        duration
+        operator -()
+            const
+        {
+            return duration{} - *this;
+        }
+
+        // Division by 2, rounding towards negative infinity.
+        constexpr
+        duration
+        half()
+            const noexcept
+        {
+            return from_raw(raw >> 1);
+        }
+
+
+        constexpr
+        std::strong_ordering operator <=>(const duration& other) const noexcept = default;
+
+    };
+
+
     // This is u32.32 fixed-point format, seconds since 1900-01-01 00:00:00 UTC
     class timestamp {
 
@@ -43,24 +125,88 @@ namespace ntp {
 
 
         // These will byteswap if necessary.
-        std::uint64_t load() const noexcept;
-        void store(std::uint64_t v) noexcept;
+        constexpr
+        std::uint64_t
+        load()
+            const noexcept
+        {
+            if constexpr (std::endian::native == std::endian::big)
+                return stored;
+            else
+                return std::byteswap(stored);
+        }
+
+        constexpr
+        void
+        store(std::uint64_t v)
+            noexcept
+        {
+            if constexpr (std::endian::native == std::endian::big)
+                stored = v;
+            else
+                stored = std::byteswap(v);
+        }
 
 
         constexpr
         bool operator ==(const timestamp& other) const noexcept = default;
 
-        std::strong_ordering operator <=>(timestamp other) const noexcept;
+        constexpr
+        std::strong_ordering
+        operator <=>(timestamp other)
+            const noexcept
+        {
+            return load() <=> other.load();
+        }
 
     };
-    // TODO: implement difference calculations for timestamps, as recommended by the RFC.
-    // Differences sould be done in fixed-point, should check for overflows, and return
-    // floating-point.
+
+
+    /*
+     * Era-aware difference between timestamps.
+     *
+     * The result is the shortest signed distance from b to a, modulo 2^32 seconds, so it
+     * is always correct when both timestamps are less than 68 years apart, even if one of
+     * them is in the next era (after 2036).
+     */
+    constexpr
+    duration
+    operator -(timestamp a, timestamp b)
+        noexcept
+    {
+        // Unsigned subtraction wraps around, the cast turns it into the signed distance.
+        return duration::from_raw(static_cast<std::int64_t>(a.load() - b.load()));
+    }
+
+
+    // Era-aware; wraps around at the end of the era.
+    constexpr
+    timestamp
+    operator +(timestamp t, duration d)
+        noexcept
+    {
+        timestamp result;
+        result.store(t.load() + static_cast<std::uint64_t>(d.raw_value()));
+        return result;
+    }
+
+
+    // Era-aware midpoint between timestamps.
+    constexpr
+    timestamp
+    midpoint(timestamp a, timestamp b)
+        noexcept
+    {
+        return a + (b - a).half();
+    }
 
 
     // This is a u16.16 fixed-point format.
     using short_timestamp = std::uint32_t;
 
+    // Converts from big-endian u16.16 to seconds.
+    dbl_seconds to_dbl_seconds(short_timestamp t) noexcept;
+
 
     // Note: all fields are big-endian
     struct packet {
@@ -118,6 +264,111 @@ namespace ntp {
 
     std::string to_string(packet::mode_flag m);
 
+
+    // Frequency tolerance (15 ppm), how fast the dispersion grows with time.
+    constexpr double phi = 15e-6;
+
+
+    // One measurement of a server's clock, see RFC 5905 section 8.
+    struct sample {
+        dbl_seconds offset;     // how much the local clock is behind the server (theta)
+        dbl_seconds delay;      // round-trip delay (delta)
+        dbl_seconds dispersion; // maximum error from precision and frequency tolerance (epsilon)
+        dbl_seconds time;       // local time when the sample was taken
+
+        // These come from the server.
+        unsigned    stratum = 0;
+        dbl_seconds root_delay{0};
+        dbl_seconds root_dispersion{0};
+    };
+
+
+    /*
+     * The clock filter algorithm, from RFC 5905 section 10.
+     *
+     * It keeps a window with the most recent samples from one server, and picks the one
+     * with the lowest round-trip delay, since it's the one least affected by queuing.
+     *
+     * Note: unlike the RFC, empty slots are not padded with maximum dispersion, so a
+     * single burst is enough to get a usable estimate.
+     */
+    class clock_filter {
+
+        std::vector<sample> samples; // from oldest to newest
+
+    public:
+
+        static constexpr std::size_t max_size = 8;
+
+
+        void add(const sample& s);
+
+        bool empty() const noexcept;
+
+        std::size_t size() const noexcept;
+
+
+        // The sample with the lowest delay. Must not be empty.
+        const sample& best() const;
+
+        // Filtered offset, delay and dispersion of the server.
+        dbl_seconds offset() const;
+        dbl_seconds delay() const;
+        dbl_seconds dispersion() const;
+
+        // RMS of the offset differences, relative to the best sample.
+        dbl_seconds jitter() const;
+
+        /*
+         * Root distance (lambda): maximum error of the offset, relative to the primary
+         * reference source at the root of the synchronization subnet.
+         */
+        dbl_seconds root_distance() const;
+
+    };
+
+
+    // Maximum root distance for a server to be used by the selection algorithm.
+    constexpr dbl_seconds max_distance{1.5};
+
+    // Minimum number of survivors after clustering.
+    constexpr std::size_t min_cluster = 3;
+
+
+    struct selection {
+        dbl_seconds offset; // combined offset of the survivors
+        dbl_seconds error;  // the true offset is within offset ± error
+        dbl_seconds jitter; // system jitter, from the survivors' offsets
+
+        std::vector<std::size_t> truechimers; // indexes of the candidates that agreed
+        std::vector<std::size_t> survivors;   // indexes of the candidates combined
+    };
+
+
+    /*
+     * How many candidates agree on the time: the largest number of correctness intervals
+     * (offset ± root distance) with a point in common. Unsuitable candidates are ignored,
+     * like in select().
+     */
+    std::size_t agreement(const std::vector<clock_filter>& candidates);
+
+
+    // Whether select() would find a majority of the candidates agreeing on the time.
+    bool has_majority(const std::vector<clock_filter>& candidates);
+
+
+    /*
+     * The clock select, cluster and combine algorithms, from RFC 5905 section 11.2.
+     *
+     * Each candidate has a correctness interval, offset ± root distance. The intersection
+     * algorithm finds the largest group of candidates whose intervals overlap; those are the
+     * truechimers, the others are falsetickers. The cluster algorithm then discards the
+     * outliers, and the survivors are combined, weighted by their root distance.
+     *
+     * Throws std::runtime_error if no majority of candidates agrees.
+     */
+    selection select(const std::vector<clock_filter>& candidates);
+
 } // namespace ntp
 
 #endif
@@ -0,0 +1,233 @@
+/*
+ * Wii U Time Sync - A NTP client plugin for the Wii U.
+ *
+ * Copyright (C) 2025  Daniel K. O.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef NTP_SESSION_HPP
+#define NTP_SESSION_HPP
+
+#include <chrono>
+#include <cstddef>              // size_t
+#include <cstdint>
+#include <deque>
+#include <expected>
+#include <map>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "coro.hpp"
+#include "net/address.hpp"
+#include "net/reactor.hpp"
+#include "net/socket.hpp"
+#include "ntp.hpp"
+#include "utc.hpp"
+
+
+/*
+ * Sends NTP requests to any number of servers through a single unconnected UDP socket,
+ * and collects the replies with a single recvfrom() loop. Replies are matched to their
+ * requests by the origin timestamp, so only one socket and one poll() slot are needed,
+ * no matter how many servers are queried.
+ *
+ * The session runs as a coroutine on a net::reactor, so other coroutines can run on the
+ * same thread while it waits for replies.
+ *
+ * Each server can be sent a burst of requests; all the samples are fed into the
+ * server's clock filter.
+ *
+ * Unanswered requests are sent again, with a retransmission timeout (RTO) estimated
+ * from each server's round-trip times, like TCP does (RFC 6298). A reply to any of the
+ * copies is accepted, so one lost datagram doesn't cost the whole timeout.
+ */
+class ntp_session {
+
+public:
+
+    using clock = std::chrono::steady_clock;
+
+
+    struct response {
+        net::address address;
+        std::expected<ntp::clock_filter, std::string> result;
+    };
+
+
+    // The interval is the spacing between requests in a burst.
+    explicit
+    ntp_session(std::chrono::milliseconds interval = std::chrono::seconds{2});
+
+
+    /*
+     * Schedule a burst of `count` requests to address; can be called while it's running.
+     * The first RTO is estimated from `rtt`, when the server's round-trip time is known
+     * from earlier syncs.
+     */
+    void
+    add(net::address address,
+        unsigned count = 1,
+        std::optional<std::chrono::milliseconds> rtt = {});
+
+
+    /*
+     * While open, run() keeps going after it runs out of servers, waiting for other
+     * coroutines on the same reactor to add() more; close() lets it finish.
+     */
+    void open() noexcept;
+
+    void close() noexcept;
+
+
+    // Limit how many servers are sampled at the same time; zero means no limit.
+    void
+    set_max_active(std::size_t n)
+        noexcept;
+
+
+    /*
+     * Start the servers one at a time, in the order they were added. With a quorum,
+     * another server only starts when the ones running can't reach it: either they
+     * failed, or one didn't reply within `delay`. On a healthy network, a quorum of one
+     * then needs a single request. Zero starts them all at once.
+     */
+    void
+    set_stagger(std::chrono::milliseconds delay)
+        noexcept;
+
+
+    /*
+     * Send all scheduled requests, and wait for their replies, as a coroutine on the
+     * reactor; cancellation is done through the reactor. Each request waits up to
+     * `timeout` for its reply.
+     *
+     * Results are returned in the order the servers finished; servers that produced no
+     * valid sample are reported with the last error.
+     *
+     * If `quorum` is not zero, the session ends as soon as that many finished servers
+     * agree on the time (see ntp::agreement()), and they are a majority of the finished
+     * servers (see ntp::has_majority()); servers that didn't finish by then are left out
+     * of the results.
+     */
+    coro::task<std::vector<response>>
+    run(net::reactor& reactor,
+        std::chrono::milliseconds timeout,
+        std::size_t quorum = 0);
+
+
+    // When the most recent valid sample was taken.
+    utc::clock_anchor
+    anchor()
+        const noexcept;
+
+private:
+
+    struct server {
+        net::address address;
+        unsigned to_send = 0;      // requests not sent yet
+        unsigned outstanding = 0;  // requests sent, but not answered yet
+        clock::time_point next_send;
+        clock::time_point launched;
+        ntp::clock_filter filter;
+        std::string error;
+        unsigned next_slot = 0;    // which request of the burst is sent next
+        // RTO estimator state.
+        clock::duration srtt{0};
+        clock::duration rttvar{0};
+        clock::duration rto;
+        bool started = false;
+        bool finished = false;
+    };
+
+    struct request {
+        std::size_t server_idx;
+        unsigned slot;         // copies of the same request share the slot
+        unsigned attempt = 0;  // zero for the original, then each retransmission
+        std::int64_t t1_ticks = 0; // monotonic system ticks, when the request was sent
+        clock::time_point expiration;
+        clock::time_point retransmit = clock::time_point::max();
+    };
+
+
+    std::chrono::milliseconds interval;
+
+    net::socket sock;
+
+    // Note: a deque, so servers can be added while references to them are held.
+    std::deque<server> servers;
+
+    bool accepting = false;
+
+    std::size_t max_active = 0;
+
+    std::chrono::milliseconds stagger{0};
+
+    // When the next server may start, if staggered.
+    clock::time_point next_launch;
+
+    // Where run() is suspended while waiting, so add() and close() can wake it up.
+    net::reactor* waiting_reactor = nullptr;
+    net::reactor::wait_op* waiting_op = nullptr;
+
+    struct waiting_guard;
+
+    utc::clock_anchor latest_anchor;
+
+    // Outstanding requests, indexed by their transmit timestamp.
+    std::map<ntp::timestamp, request> requests;
+
+
+    // Send the requests back-to-back; returns the ones that failed.
+    std::vector<request>
+    send_batch(const std::vector<request>& batch);
+
+    coro::task<void>
+    send(net::reactor& reactor,
+         request req);
+
+    // Track the request, and schedule its retransmission.
+    void
+    sent(ntp::timestamp key,
+         request req);
+
+    void
+    update_rto(server& s,
+               clock::duration rtt)
+        noexcept;
+
+    // The first transmit timestamp, from `key` onwards, not used by any outstanding request.
+    ntp::timestamp
+    unique_key(ntp::timestamp key)
+        const;
+
+    void
+    expire(clock::time_point now);
+
+    // Returns true if any server was reported.
+    bool
+    finish(std::vector<response>& results);
+
+    // When the next server may start, if staggered.
+    clock::time_point
+    launch_time(clock::time_point now,
+                const std::vector<response>& results,
+                std::size_t quorum)
+        const;
+
+    static
+    bool
+    quorum_reached(const std::vector<response>& results,
+                   std::size_t quorum);
+
+    void
+    drain();
+
+    void
+    wake_up()
+        noexcept;
+
+};
+
+#endif
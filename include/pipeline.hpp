@@ -0,0 +1,74 @@
+/*
+ * Wii U Time Sync - A NTP client plugin for the Wii U.
+ *
+ * Copyright (C) 2025  Daniel K. O.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef PIPELINE_HPP
+#define PIPELINE_HPP
+
+#include <chrono>
+#include <cstddef>              // size_t
+#include <memory>               // shared_ptr<>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "coro.hpp"
+#include "net/address.hpp"
+#include "net/addrinfo.hpp"
+#include "net/reactor.hpp"
+#include "ntp_session.hpp"
+#include "thread_pool.hpp"
+
+
+/*
+ * State shared by the DNS and NTP stages of a sync: every new address is queried as soon
+ * as it's known, while the other names are still being resolved.
+ */
+struct pipeline {
+
+    ntp_session session;
+    unsigned burst;
+    std::set<net::address> seen;
+    std::size_t fed = 0;
+    std::vector<net::address> reserves; // dead addresses, best first
+    unsigned feeders = 0; // DNS stages still running
+
+
+    explicit
+    pipeline(unsigned burst);
+
+
+    // The best addresses are queried first; dead ones are kept as reserves.
+    void feed(const std::vector<net::address>& addresses);
+
+    // Dead addresses are only worth a timeout when there aren't enough others.
+    void use_reserves();
+
+    // Called by each DNS stage when it's done; the last one closes the session.
+    void done_feeding();
+
+};
+
+
+/*
+ * Resolve the names, and feed each answer into the pipeline as it arrives.
+ *
+ * Names the console's DNS servers don't answer are looked up with getaddrinfo(), on a
+ * `pool` worker; those that don't finish within `timeout` are reported as failed, and left
+ * running.
+ */
+coro::task<void>
+resolve_stage(net::reactor& reactor,
+              std::shared_ptr<pipeline> pipe,
+              std::vector<std::string> names,
+              std::string service,
+              net::addrinfo::hints opts,
+              std::chrono::milliseconds timeout,
+              thread_pool& pool,
+              bool silent);
+
+#endif
@@ -0,0 +1,80 @@
+/*
+ * Wii U Time Sync - A NTP client plugin for the Wii U.
+ *
+ * Copyright (C) 2025  Daniel K. O.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef SCOREBOARD_HPP
+#define SCOREBOARD_HPP
+
+#include <chrono>
+#include <optional>
+#include <vector>
+
+#include "net/address.hpp"
+#include "ntp.hpp"
+
+
+/*
+ * Health of each NTP server address, from the previous syncs. It's stored along with the
+ * configuration, so the next sync can query the best servers first, and avoid the ones
+ * that keep failing.
+ */
+
+namespace scoreboard {
+
+    struct stats {
+        double   success = 0.75;  // moving average of the success rate, from 0 to 1
+        double   rtt = 0.1;       // moving average of the round-trip delay, in seconds
+        double   rttvar = 0.05;   // moving average of the round-trip delay's deviation
+        double   jitter = 0.01;   // moving average of the jitter, in seconds
+        unsigned stratum = 2;
+        unsigned failures = 0;    // consecutive failures
+        double   last_failure = 0; // UTC seconds since 2000; zero if it never failed
+        double   last_seen = 0;    // UTC seconds since 2000, at the last update
+    };
+
+
+    // Load the scoreboard from storage.
+    void load() noexcept;
+
+
+    // Returns nothing if the address was never queried.
+    std::optional<stats>
+    find(net::address addr);
+
+
+    // The round-trip time to the address, if its last query succeeded.
+    std::optional<std::chrono::milliseconds>
+    expected_rtt(net::address addr);
+
+
+    // Record a valid measurement from the address.
+    void
+    success(net::address addr,
+            const ntp::clock_filter& filter);
+
+
+    // Record that the address didn't reply, or was discarded.
+    void
+    failure(net::address addr);
+
+
+    // Save all recorded results; done once per sync.
+    void store();
+
+
+    // True if the address failed too many times recently, and should not be queried.
+    bool
+    is_dead(net::address addr);
+
+
+    // Sort the addresses from best to worst; dead addresses go last.
+    std::vector<net::address>
+    rank(std::vector<net::address> addrs);
+
+} // namespace scoreboard
+
+#endif
@@ -0,0 +1,173 @@
+/*
+ * Wii U Time Sync - A NTP client plugin for the Wii U.
+ *
+ * Copyright (C) 2025  Daniel K. O.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef SMALL_TASK_HPP
+#define SMALL_TASK_HPP
+
+#include <cstddef>              // byte, max_align_t, size_t
+#include <functional>           // invoke()
+#include <memory>               // unique_ptr<>
+#include <new>                  // launder()
+#include <type_traits>
+#include <utility>              // exchange(), forward(), move()
+
+
+/*
+ * A move-only callable with no arguments, like std::move_only_function<R()>, but
+ * callables up to `capacity` bytes are stored inline, so they don't need a heap
+ * allocation. Larger callables still work, they are just stored on the heap.
+ */
+template<typename R>
+class small_task {
+
+public:
+
+    static constexpr std::size_t capacity = 128;
+
+private:
+
+    struct vtable {
+        R    (*call)(void* self);
+        void (*move)(void* from, void* to) noexcept;
+        void (*destroy)(void* self) noexcept;
+    };
+
+
+    template<typename F>
+    static constexpr bool fits_inline = sizeof(F) <= capacity
+                                     && alignof(F) <= alignof(std::max_align_t)
+                                     && std::is_nothrow_move_constructible_v<F>;
+
+
+    template<typename F>
+    static
+    F*
+    inline_ptr(void* p)
+        noexcept
+    {
+        return std::launder(static_cast<F*>(p));
+    }
+
+
+    template<typename F>
+    static constexpr vtable inline_vtable = {
+        [](void* self) -> R
+        {
+            return std::invoke(*inline_ptr<F>(self));
+        },
+        [](void* from, void* to) noexcept
+        {
+            new (to) F(std::move(*inline_ptr<F>(from)));
+            inline_ptr<F>(from)->~F();
+        },
+        [](void* self) noexcept
+        {
+            inline_ptr<F>(self)->~F();
+        }
+    };
+
+
+    // Large callables: the buffer holds a pointer to the heap.
+    template<typename F>
+    static constexpr vtable heap_vtable = {
+        [](void* self) -> R
+        {
+            return std::invoke(**static_cast<F**>(self));
+        },
+        [](void* from, void* to) noexcept
+        {
+            *static_cast<F**>(to) = std::exchange(*static_cast<F**>(from), nullptr);
+        },
+        [](void* self) noexcept
+        {
+            delete *static_cast<F**>(self);
+        }
+    };
+
+
+    alignas(std::max_align_t) std::byte buffer[capacity];
+    const vtable* vt = nullptr;
+
+public:
+
+    small_task() noexcept = default;
+
+
+    template<typename F>
+        requires (!std::is_same_v<std::remove_cvref_t<F>, small_task>)
+    small_task(F&& f)
+    {
+        using Fn = std::decay_t<F>;
+        if constexpr (fits_inline<Fn>) {
+            new (buffer) Fn(std::forward<F>(f));
+            vt = &inline_vtable<Fn>;
+        } else {
+            auto p = std::make_unique<Fn>(std::forward<F>(f));
+            new (buffer) Fn*(p.release());
+            vt = &heap_vtable<Fn>;
+        }
+    }
+
+
+    small_task(small_task&& other)
+        noexcept
+    {
+        if (other.vt) {
+            other.vt->move(other.buffer, buffer);
+            vt = std::exchange(other.vt, nullptr);
+        }
+    }
+
+
+    small_task&
+    operator =(small_task&& other)
+        noexcept
+    {
+        if (this != &other) {
+            reset();
+            if (other.vt) {
+                other.vt->move(other.buffer, buffer);
+                vt = std::exchange(other.vt, nullptr);
+            }
+        }
+        return *this;
+    }
+
+
+    ~small_task()
+    {
+        reset();
+    }
+
+
+    void
+    reset()
+        noexcept
+    {
+        if (vt)
+            std::exchange(vt, nullptr)->destroy(buffer);
+    }
+
+
+    explicit
+    operator bool()
+        const noexcept
+    {
+        return vt;
+    }
+
+
+    R
+    operator ()()
+    {
+        return vt->call(buffer);
+    }
+
+};
+
+#endif
@@ -9,16 +9,17 @@
 #ifndef SYNCHRONIZE_ITEM_HPP
 #define SYNCHRONIZE_ITEM_HPP
 
-#include <future>
 #include <memory>
 #include <stop_token>
 
 #include <wupsxx/button_item.hpp>
 
+#include "task_future.hpp"
+
 
 struct synchronize_item : wups::button_item {
 
-    std::future<void> task_result;
+    task_future<void> task_result;
     std::stop_source task_stopper;
 
 
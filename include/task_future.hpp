@@ -0,0 +1,308 @@
+/*
+ * Wii U Time Sync - A NTP client plugin for the Wii U.
+ *
+ * Copyright (C) 2025  Daniel K. O.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef TASK_FUTURE_HPP
+#define TASK_FUTURE_HPP
+
+#include <atomic>
+#include <exception>            // current_exception(), exception_ptr, rethrow_exception()
+#include <future>               // future_errc, future_error
+#include <mutex>
+#include <optional>
+#include <type_traits>          // conditional_t<>, is_void_v<>
+#include <utility>              // exchange(), move()
+#include <vector>
+
+#include "small_task.hpp"
+
+
+// A unit of work in thread_pool's queues.
+struct task_base {
+
+    // Run the task, and drop the queue's reference to it.
+    virtual void run() noexcept = 0;
+
+    // The task will never run; its future gets a broken_promise error.
+    virtual void abandon() noexcept = 0;
+
+protected:
+
+    ~task_base() = default;
+
+};
+
+
+// Keeps track of every task_state<T> free list, so they can all be emptied at once.
+class task_state_pools {
+
+    using drain_func = void (*)() noexcept;
+
+    static inline std::mutex mutex;
+    static inline std::vector<drain_func> drains;
+
+public:
+
+    static
+    void
+    add(drain_func drain)
+    {
+        std::lock_guard guard{mutex};
+        drains.push_back(drain);
+    }
+
+
+    // Free all recycled states; states still in use are recycled as usual.
+    static
+    void
+    drain_all()
+        noexcept
+    {
+        std::lock_guard guard{mutex};
+        for (auto drain : drains)
+            drain();
+    }
+
+};
+
+
+/*
+ * The shared state between a queued task and its task_future: the callable, and then its
+ * result. States are recycled through a per-type free list, so in steady state submitting
+ * a task allocates nothing.
+ */
+template<typename T>
+class task_state final : public task_base {
+
+    struct empty {};
+    using value_type = std::conditional_t<std::is_void_v<T>, empty, T>;
+
+
+    std::atomic<unsigned> refs = 0;
+    std::atomic<bool> ready = false;
+    small_task<T> func;
+    std::optional<value_type> value;
+    std::exception_ptr error;
+
+    task_state* next_free = nullptr;
+
+
+    static inline std::mutex free_mutex;
+    static inline task_state* free_list = nullptr;
+
+
+    static
+    void
+    drain()
+        noexcept
+    {
+        task_state* list;
+        {
+            std::lock_guard guard{free_mutex};
+            list = std::exchange(free_list, nullptr);
+        }
+        while (list)
+            delete std::exchange(list, list->next_free);
+    }
+
+
+    void
+    finish()
+        noexcept
+    {
+        func.reset();
+        ready.store(true, std::memory_order_release);
+        ready.notify_all();
+        release();
+    }
+
+public:
+
+    // Returns a state with two references: one for the queue, one for the future.
+    template<typename F>
+    static
+    task_state*
+    acquire(F&& f)
+    {
+        task_state* s = nullptr;
+        {
+            std::lock_guard guard{free_mutex};
+            if (free_list)
+                s = std::exchange(free_list, free_list->next_free);
+        }
+        if (!s) {
+            // Note: registered on first use, so task_state_pools::drain_all() sees it.
+            static const bool registered = (task_state_pools::add(&drain), true);
+            (void)registered;
+            s = new task_state;
+        }
+        try {
+            s->func = small_task<T>{std::forward<F>(f)};
+        }
+        catch (...) {
+            std::lock_guard guard{free_mutex};
+            s->next_free = std::exchange(free_list, s);
+            throw;
+        }
+        s->refs.store(2, std::memory_order_relaxed);
+        return s;
+    }
+
+
+    void
+    release()
+        noexcept
+    {
+        if (refs.fetch_sub(1, std::memory_order_acq_rel) != 1)
+            return;
+        value.reset();
+        error = nullptr;
+        ready.store(false, std::memory_order_relaxed);
+        std::lock_guard guard{free_mutex};
+        next_free = std::exchange(free_list, this);
+    }
+
+
+    void
+    run()
+        noexcept override
+    {
+        try {
+            if constexpr (std::is_void_v<T>) {
+                func();
+                value.emplace();
+            } else
+                value.emplace(func());
+        }
+        catch (...) {
+            error = std::current_exception();
+        }
+        finish();
+    }
+
+
+    void
+    abandon()
+        noexcept override
+    {
+        error = std::make_exception_ptr(std::future_error{std::future_errc::broken_promise});
+        finish();
+    }
+
+
+    bool
+    is_ready()
+        const noexcept
+    {
+        return ready.load(std::memory_order_acquire);
+    }
+
+
+    void
+    wait()
+        const noexcept
+    {
+        ready.wait(false, std::memory_order_acquire);
+    }
+
+
+    T
+    get()
+    {
+        wait();
+        if (error)
+            std::rethrow_exception(error);
+        if constexpr (!std::is_void_v<T>)
+            return std::move(*value);
+    }
+
+};
+
+
+// Like std::future, for tasks submitted to thread_pool.
+template<typename T>
+class task_future {
+
+    task_state<T>* state = nullptr;
+
+public:
+
+    task_future() noexcept = default;
+
+
+    explicit
+    task_future(task_state<T>* s)
+        noexcept :
+        state{s}
+    {}
+
+
+    task_future(task_future&& other)
+        noexcept :
+        state{std::exchange(other.state, nullptr)}
+    {}
+
+
+    task_future&
+    operator =(task_future&& other)
+        noexcept
+    {
+        if (this != &other) {
+            if (state)
+                state->release();
+            state = std::exchange(other.state, nullptr);
+        }
+        return *this;
+    }
+
+
+    ~task_future()
+    {
+        if (state)
+            state->release();
+    }
+
+
+    bool
+    valid()
+        const noexcept
+    {
+        return state;
+    }
+
+
+    bool
+    is_ready()
+        const noexcept
+    {
+        return state->is_ready();
+    }
+
+
+    void
+    wait()
+        const noexcept
+    {
+        state->wait();
+    }
+
+
+    // Like std::future::get(), this can only be called once.
+    T
+    get()
+    {
+        task_state<T>* s = std::exchange(state, nullptr);
+        struct releaser {
+            task_state<T>* s;
+            ~releaser() { s->release(); }
+        } guard{s};
+        return s->get();
+    }
+
+};
+
+#endif
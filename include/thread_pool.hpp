@@ -9,36 +9,126 @@
 #ifndef THREAD_POOL_HPP
 #define THREAD_POOL_HPP
 
+#include <array>
 #include <atomic>
-#include <exception>
-#include <functional>           // bind(), move_only_function<>
-#include <future>
+#include <chrono>
+#include <cstddef>              // size_t
+#include <functional>           // invoke()
+#include <memory>               // unique_ptr<>
 #include <mutex>
+#include <optional>
 #include <thread>
+#include <tuple>
 #include <type_traits>          // decay_t<>, invoke_result_t<>
 #include <utility>              // forward(), move()
 #include <vector>
 
 #include "async_queue.hpp"
+#include "mpmc_ring.hpp"
+#include "task_future.hpp"
+#include "work_stealing_deque.hpp"
 
 
+/*
+ * Each worker has its own work-stealing deque. Tasks submitted by a worker go to its own
+ * deque, and idle workers steal from the others; tasks submitted by other threads go
+ * through the shared queue, where idle workers sleep.
+ */
 class thread_pool {
 
-    unsigned max_workers;
+    // Tasks live in their pooled task_state, the queues only pass pointers around.
+    using task_type = task_base*;
+
+
+    struct worker {
+        // Note: declared first, so it's destroyed after the thread is joined.
+        work_stealing_deque<task_base> local;
+        std::jthread thread;
+
+        enum class state {
+            running,
+            exited,
+            abandoned, // detached by release_workers()
+        };
+        std::atomic<state> status = state::running;
+    };
+
+
+    enum class dispatch {
+        caller,
+        local,
+        shared,
+    };
+
+
+public:
+
+    // Upper limit for the number of workers.
+    static constexpr unsigned max_threads = 16;
+
+private:
 
-    std::vector<std::jthread> workers;
+    // Note: only needed to add or remove workers; submitting and stealing don't lock it.
+    std::mutex workers_mutex;
 
-    // Note: we can't use std::function because we're putting std::packaged_task in there,
-    // and std::packaged_task is only movable, but std::function always tries to copy.
-    using task_type = std::move_only_function<void()>;
-    async_queue<task_type> tasks;
+    std::atomic<unsigned> max_workers;
+
+    std::vector<std::unique_ptr<worker>> workers;
+    // Detached workers, only destroyed with the pool.
+    std::vector<std::unique_ptr<worker>> abandoned;
+
+    // Workers stopped by resize(), they are joined later, so resize() never blocks.
+    std::vector<std::unique_ptr<worker>> retired;
+
+    /*
+     * Where thieves find the other workers: slots[i] is workers[i], or null. A worker is
+     * only destroyed after all workers are joined, so a thief never sees a dangling
+     * pointer.
+     */
+    std::array<std::atomic<worker*>, max_threads> slots{};
+
+    // Same as workers.size(), for the lock-free checks.
+    std::atomic<unsigned> num_workers = 0;
+
+    // Note: bounded, so submit() from outside the pool blocks while it's full.
+    using task_queue = async_queue<task_type, mpmc_ring<task_type, 64>>;
+
+    // A null task is pushed here only to wake up an idle worker, so it steals.
+    task_queue tasks;
 
     std::atomic_int num_idle_workers = 0;
 
-    void worker_thread(std::stop_token token);
+    // Tasks dispatched to the queues, but not taken by any thread yet.
+    std::atomic_int num_queued = 0;
+
+    // Abandoned workers that didn't exit yet; the destructor waits for them.
+    std::atomic<unsigned> num_detached = 0;
+
+    // The pool the current thread is a worker of, and which worker.
+    static thread_local thread_pool* current;
+    static thread_local worker* current_worker;
+
+    void worker_thread(std::stop_token token, worker& self);
+
+    task_type next_task(std::stop_token token, worker& self);
+
+    task_type steal(const worker& thief);
 
     void add_worker();
 
+    void grow_if_needed();
+
+    dispatch prepare_dispatch();
+
+    void push_local(task_type task);
+
+    void dispatch_task(task_type task);
+
+    void enqueue_task(task_type task);
+
+    // Runs one task from the current worker's deque, returns false if it was empty.
+    bool run_local();
+
 public:
 
     thread_pool(unsigned max_workers);
@@ -46,33 +136,94 @@ public:
     ~thread_pool();
 
 
-    // This method behaves like std::async().
+    /*
+     * Change the maximum number of workers, up to max_threads. Extra workers are stopped once they finish
+     * their current task; their pending tasks are handed to the remaining workers.
+     */
+    void resize(unsigned new_max_workers);
+
+
+    /*
+     * Stop and join all workers. New workers are created on demand by submit().
+     *
+     * With a timeout, workers that don't stop in time (stuck in a blocking call) are
+     * detached instead, and their pending tasks handed to the other workers. Returns how
+     * many were detached.
+     */
+    std::size_t
+    release_workers(std::optional<std::chrono::milliseconds> timeout = {});
+
+
+    /*
+     * This method behaves like std::async(), but returns a task_future.
+     *
+     * When the pool has no workers at all, or a worker submits a task while all others
+     * are busy, the task is executed immediately by the caller. That way a worker that
+     * waits on tasks it submitted can't deadlock the pool.
+     */
     template<typename Func, typename... Args>
-    std::future<std::invoke_result_t<std::decay_t<Func>,
+    task_future<std::invoke_result_t<std::decay_t<Func>,
                                      std::decay_t<Args>...>>
     submit(Func&& func, Args&&... args)
     {
         using Ret = std::invoke_result_t<std::decay_t<Func>, std::decay_t<Args>...>;
 
-        auto bfunc = std::bind(std::forward<Func>(func),
-                               std::forward<Args>(args)...);
+        auto call = [func = std::forward<Func>(func),
+                     args = std::make_tuple(std::forward<Args>(args)...)]() mutable -> Ret
+        {
+            return std::apply(std::move(func), std::move(args));
+        };
+
+        auto state = task_state<Ret>::acquire(std::move(call));
+        task_future<Ret> future{state};
+        dispatch_task(state);
+        return future;
+    }
 
-        std::packaged_task<Ret()> task{std::move(bfunc)};
-        auto future = task.get_future();
 
-        if (max_workers == 0)
-            task(); // If no worker will handle this, execute it immediately.
-        else {
-            // If all threads are busy, try to add another to the pool.
-            if (num_idle_workers == 0)
-                add_worker();
+    /*
+     * Like submit(), but the task is never executed by the caller, nor pushed to the
+     * caller's own deque: it always goes to the shared queue, for some other worker. Use
+     * this from threads that must not block, like a worker running a reactor. If the queue
+     * is full, the task is abandoned: its future throws std::future_error.
+     */
+    template<typename Func, typename... Args>
+    task_future<std::invoke_result_t<std::decay_t<Func>,
+                                     std::decay_t<Args>...>>
+    enqueue(Func&& func, Args&&... args)
+    {
+        using Ret = std::invoke_result_t<std::decay_t<Func>, std::decay_t<Args>...>;
 
-            tasks.push(std::move(task));
-        }
+        auto call = [func = std::forward<Func>(func),
+                     args = std::make_tuple(std::forward<Args>(args)...)]() mutable -> Ret
+        {
+            return std::apply(std::move(func), std::move(args));
+        };
 
+        auto state = task_state<Ret>::acquire(std::move(call));
+        task_future<Ret> future{state};
+        enqueue_task(state);
         return future;
     }
 
+
+    /*
+     * Like fut.get(), but when called from a worker, it runs the worker's pending tasks
+     * while waiting. A worker waiting on tasks it submitted should use this, or those
+     * tasks could be stuck in its own deque.
+     */
+    template<typename T>
+    T
+    get(task_future<T>& fut)
+    {
+        if (current == this)
+            while (!fut.is_ready())
+                if (!run_local())
+                    break;
+        return fut.get();
+    }
+
+
 };
 
 #endif
@@ -9,6 +9,8 @@
 #ifndef UTC_HPP
 #define UTC_HPP
 
+#include <cstdint>
+
 #include "time_utils.hpp"
 
 
@@ -27,6 +29,27 @@ namespace utc {
     now()
         noexcept;
 
+
+    /*
+     * Value to add to the monotonic system ticks (OSGetSystemTime()) to get UTC ticks,
+     * since 2000-01-01 00:00:00 UTC. It changes whenever the clock is set.
+     */
+    std::int64_t
+    system_ticks_offset()
+        noexcept;
+
+
+    // A monotonic system tick count, paired with the local clock at that same moment.
+    struct clock_anchor {
+        std::int64_t system_ticks = 0;
+        std::int64_t local_ticks  = 0;
+    };
+
+
+    clock_anchor
+    make_anchor(std::int64_t system_ticks)
+        noexcept;
+
 } // namespace utc
 
 #endif
@@ -12,6 +12,7 @@
 #include <atomic>
 #include <chrono>
 #include <cstddef>              // size_t
+#include <stop_token>
 #include <string>
 #include <utility>              // pair<>
 #include <vector>
@@ -31,6 +32,15 @@ namespace utils {
           std::size_t max_tokens = 0);
 
 
+    /*
+     * Block until the deadline, or until a stop is requested, whichever happens first.
+     * Returns false if it was stopped.
+     */
+    bool
+    wait_until(std::stop_token token,
+               std::chrono::steady_clock::time_point deadline);
+
+
     // RAII type to ensure a function is never executed in parallel.
     struct exec_guard {
 
@@ -0,0 +1,172 @@
+/*
+ * Wii U Time Sync - A NTP client plugin for the Wii U.
+ *
+ * Copyright (C) 2025  Daniel K. O.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef WORK_STEALING_DEQUE_HPP
+#define WORK_STEALING_DEQUE_HPP
+
+#include <atomic>
+#include <cstddef>              // ptrdiff_t, size_t
+#include <memory>               // unique_ptr<>
+#include <vector>
+
+
+/*
+ * Chase-Lev work-stealing deque, with the memory orderings from "Correct and Efficient
+ * Work-Stealing for Weak Memory Models" (Lê, Pop, Cohen, Zappa Nardelli, 2013).
+ *
+ * Only the owner thread may call push() and take(), which work on the bottom end; any
+ * thread may call steal(), which works on the top end. Elements are pointers, and a null
+ * pointer means "empty".
+ *
+ * Arrays replaced when growing are kept until the deque is destroyed, since a thief might
+ * still be reading from them.
+ */
+template<typename T>
+class work_stealing_deque {
+
+    struct array {
+
+        std::size_t mask;
+        std::unique_ptr<std::atomic<T*>[]> slots;
+
+        explicit
+        array(std::size_t capacity) :
+            mask{capacity - 1},
+            slots{new std::atomic<T*>[capacity]}
+        {}
+
+        std::size_t
+        capacity()
+            const noexcept
+        {
+            return mask + 1;
+        }
+
+        T*
+        get(std::ptrdiff_t i)
+            const noexcept
+        {
+            return slots[i & mask].load(std::memory_order_relaxed);
+        }
+
+        void
+        put(std::ptrdiff_t i,
+            T* x)
+            noexcept
+        {
+            slots[i & mask].store(x, std::memory_order_relaxed);
+        }
+
+    };
+
+
+    alignas(64) std::atomic<std::ptrdiff_t> top = 0;
+    alignas(64) std::atomic<std::ptrdiff_t> bottom = 0;
+    alignas(64) std::atomic<array*> current;
+
+    // Only accessed by the owner.
+    std::vector<std::unique_ptr<array>> arrays;
+
+
+    array*
+    grow(array* a,
+         std::ptrdiff_t b,
+         std::ptrdiff_t t)
+    {
+        auto bigger = std::make_unique<array>(2 * a->capacity());
+        for (std::ptrdiff_t i = t; i < b; ++i)
+            bigger->put(i, a->get(i));
+        array* result = bigger.get();
+        arrays.push_back(std::move(bigger));
+        current.store(result, std::memory_order_release);
+        return result;
+    }
+
+public:
+
+    // Capacity must be a power of 2.
+    explicit
+    work_stealing_deque(std::size_t capacity = 32)
+    {
+        arrays.push_back(std::make_unique<array>(capacity));
+        current.store(arrays.back().get(), std::memory_order_relaxed);
+    }
+
+
+    work_stealing_deque(const work_stealing_deque&) = delete;
+
+
+    // Owner only.
+    void
+    push(T* x)
+    {
+        std::ptrdiff_t b = bottom.load(std::memory_order_relaxed);
+        std::ptrdiff_t t = top.load(std::memory_order_acquire);
+        array* a = current.load(std::memory_order_relaxed);
+        if (b - t > static_cast<std::ptrdiff_t>(a->capacity()) - 1)
+            a = grow(a, b, t);
+        a->put(b, x);
+        std::atomic_thread_fence(std::memory_order_release);
+        bottom.store(b + 1, std::memory_order_relaxed);
+    }
+
+
+    // Owner only. Returns the most recently pushed element.
+    T*
+    take()
+        noexcept
+    {
+        std::ptrdiff_t b = bottom.load(std::memory_order_relaxed) - 1;
+        array* a = current.load(std::memory_order_relaxed);
+        bottom.store(b, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        std::ptrdiff_t t = top.load(std::memory_order_relaxed);
+
+        if (t > b) {
+            // Empty.
+            bottom.store(b + 1, std::memory_order_relaxed);
+            return nullptr;
+        }
+
+        T* x = a->get(b);
+        if (t == b) {
+            // Last element, race against thieves for it.
+            if (!top.compare_exchange_strong(t, t + 1,
+                                             std::memory_order_seq_cst,
+                                             std::memory_order_relaxed))
+                x = nullptr;
+            bottom.store(b + 1, std::memory_order_relaxed);
+        }
+        return x;
+    }
+
+
+    // Any thread. Returns the oldest element; null if empty, or if another thief won.
+    T*
+    steal()
+        noexcept
+    {
+        std::ptrdiff_t t = top.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        std::ptrdiff_t b = bottom.load(std::memory_order_acquire);
+
+        if (t >= b)
+            return nullptr;
+
+        array* a = current.load(std::memory_order_acquire);
+        T* x = a->get(t);
+        if (!top.compare_exchange_strong(t, t + 1,
+                                         std::memory_order_seq_cst,
+                                         std::memory_order_relaxed))
+            return nullptr;
+        return x;
+    }
+
+};
+
+#endif
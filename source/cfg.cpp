@@ -21,8 +21,12 @@
 #include "cfg.hpp"
 
 #include "core.hpp"
+#include "dns_cache.hpp"
+#include "drift.hpp"
+#include "executor.hpp"
 #include "notify.hpp"
 #include "preview_screen.hpp"
+#include "scoreboard.hpp"
 #include "synchronize_item.hpp"
 #include "time_utils.hpp"
 #include "time_zone_offset_item.hpp"
@@ -50,6 +54,9 @@ namespace cfg {
     WUPSXX_OPTION("Synchronize After Changing Configuration",
                   bool, sync_on_changes, true);
 
+    WUPSXX_OPTION("Synchronize Periodically",
+                  bool, periodic, false);
+
     WUPSXX_OPTION("Show Notifications",
                   int, notify, 0, 0, 2);
 
@@ -71,6 +78,12 @@ namespace cfg {
     WUPSXX_OPTION("Tolerance",
                   milliseconds, tolerance, 1000ms, 0ms, 10s);
 
+    WUPSXX_OPTION("Samples Per Server",
+                  int, burst, 1, 1, 8);
+
+    WUPSXX_OPTION("Quorum",
+                  int, quorum, 0, 0, 8);
+
     WUPSXX_OPTION("Background Threads",
                   int, threads, 4, 0, 4);
 
@@ -81,6 +94,7 @@ namespace cfg {
     std::vector<wups::option_base*> all_options = {
         &sync_on_boot,
         &sync_on_changes,
+        &periodic,
         &notify,
         &msg_duration,
         &utc_offset,
@@ -88,6 +102,8 @@ namespace cfg {
         &auto_tz,
         &timeout,
         &tolerance,
+        &burst,
+        &quorum,
         &threads,
         &server,
     };
@@ -96,6 +112,7 @@ namespace cfg {
     // variables that, if changed, may affect the sync
     namespace previous {
         bool         auto_tz;
+        bool         periodic;
         milliseconds tolerance;
         int          tz_service;
         minutes      utc_offset;
@@ -106,6 +123,7 @@ namespace cfg {
     save_important_vars()
     {
         previous::auto_tz    = auto_tz.value;
+        previous::periodic   = periodic.value;
         previous::tolerance  = tolerance.value;
         previous::tz_service = tz_service.value;
         previous::utc_offset = utc_offset.value;
@@ -116,6 +134,7 @@ namespace cfg {
     important_vars_changed()
     {
         return previous::auto_tz    != auto_tz.value
+            || previous::periodic   != periodic.value
             || previous::tolerance  != tolerance.value
             || previous::tz_service != tz_service.value
             || previous::utc_offset != utc_offset.value;
@@ -133,6 +152,8 @@ namespace cfg {
 
         cat.add(make_item(sync_on_changes, "on", "off"));
 
+        cat.add(make_item(periodic, "on", "off"));
+
         cat.add(verbosity_item::create(notify));
 
         cat.add(make_item(msg_duration));
@@ -147,6 +168,10 @@ namespace cfg {
 
         cat.add(make_item(tolerance, 500ms, 100ms));
 
+        cat.add(make_item(burst));
+
+        cat.add(make_item(quorum));
+
         cat.add(make_item(threads));
 
         // show current NTP server address, no way to change it.
@@ -181,6 +206,8 @@ namespace cfg {
         notify::set_max_level(notify::level{notify.value});
         notify::set_duration(msg_duration.value);
 
+        executor::update_size();
+
         if (sync_on_changes.value && important_vars_changed()) {
             core::background::stop();
             core::background::run();
@@ -215,6 +242,9 @@ namespace cfg {
     {
         for (auto& opt : all_options)
             opt->load();
+        dns_cache::load();
+        drift::load();
+        scoreboard::load();
         notify::set_max_level(notify::level{notify.value});
         notify::set_duration(msg_duration.value);
     }
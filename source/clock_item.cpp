@@ -18,7 +18,10 @@
 
 #include "cfg.hpp"
 #include "core.hpp"
+#include "dns_cache.hpp"
 #include "net/addrinfo.hpp"
+#include "net/reactor.hpp"
+#include "ntp.hpp"
 #include "time_utils.hpp"
 #include "utils.hpp"
 
@@ -121,13 +124,14 @@ clock_item::run()
 
     net::addrinfo::hints opts{ .type = net::socket::type::udp };
 
-    dbl_seconds total = 0s;
-    unsigned num_values = 0;
+    std::vector<ntp::clock_filter> candidates;
+
+    net::reactor reactor;
 
     for (const auto& server : servers) {
         auto& si = server_infos.at(server);
         try {
-            auto infos = net::addrinfo::lookup(server, "123", opts);
+            auto infos = dns_cache::lookup(server, "123", opts);
 
             si.name->text = to_string(infos.size())
                 + (infos.size() > 1 ? " addresses."s : " address."s);
@@ -138,11 +142,13 @@ clock_item::run()
 
             for (const auto& info : infos) {
                 try {
-                    auto [correction, latency] = core::ntp_query({}, info.addr);
+                    // Note: without a stop token, the reactor always returns a result.
+                    auto filter = *reactor.run({}, core::ntp_query(reactor, info.addr));
+                    dbl_seconds correction = filter.offset();
+                    dbl_seconds latency = filter.delay() / 2.0;
                     server_corrections.push_back(correction);
                     server_latencies.push_back(latency);
-                    total += correction;
-                    ++num_values;
+                    candidates.push_back(filter);
                     logger::printf("%s (%s): correction = %s, latency = %s\n",
                                    server.c_str(),
                                    to_string(info.addr).c_str(),
@@ -177,9 +183,17 @@ clock_item::run()
         }
     }
 
-    if (num_values) {
-        dbl_seconds avg = total / num_values;
-        diff_str = ", needs "s + seconds_to_human(avg, true);
-    } else
-        diff_str = "";
+    dns_cache::store();
+
+    diff_str = "";
+    if (!candidates.empty()) {
+        try {
+            auto sel = ntp::select(candidates);
+            diff_str = ", needs "s + seconds_to_human(sel.offset, true)
+                     + " ± "s + seconds_to_human(sel.error);
+        }
+        catch (std::exception& e) {
+            logger::printf("Error: %s\n", e.what());
+        }
+    }
 }
@@ -7,15 +7,21 @@
  * SPDX-License-Identifier: MIT
  */
 
+#include <algorithm>            // clamp(), max(), min(), ranges::find()
 #include <atomic>
 #include <chrono>
+#include <cmath>                // abs(), ldexp(), llround()
+#include <condition_variable>
 #include <cstdio>               // snprintf()
-#include <numeric>              // accumulate()
-#include <ranges>               // views::zip()
+#include <exception>            // current_exception(), exception_ptr, rethrow_exception()
+#include <memory>               // make_shared(), shared_ptr
+#include <mutex>
+#include <optional>
 #include <set>
 #include <stdexcept>            // runtime_error
 #include <string>
 #include <thread>
+#include <utility>              // move()
 #include <vector>
 
 #include <coreinit/time.h>
@@ -27,13 +33,18 @@
 #include "core.hpp"
 
 #include "cfg.hpp"
+#include "dns_cache.hpp"
+#include "drift.hpp"
+#include "executor.hpp"
 #include "net/addrinfo.hpp"
+#include "net/poll_gate.hpp"
+#include "net/reactor.hpp"
 #include "net/socket.hpp"
 #include "notify.hpp"
-#include "ntp.hpp"
-#include "thread_pool.hpp"
+#include "ntp_session.hpp"
+#include "pipeline.hpp"
+#include "scoreboard.hpp"
 #include "time_utils.hpp"
-#include "utc.hpp"
 #include "utils.hpp"
 
 
@@ -47,28 +58,6 @@ using time_utils::dbl_seconds;
 
 namespace {
 
-    // Difference from NTP (1900) to Wii U (2000) epochs.
-    // There are 24 leap years in this period.
-    constexpr dbl_seconds seconds_per_day{24 * 60 * 60};
-    constexpr dbl_seconds epoch_diff = seconds_per_day * (100 * 365 + 24);
-
-
-    // Wii U -> NTP epoch.
-    ntp::timestamp
-    to_ntp(utc::timestamp t)
-    {
-        return ntp::timestamp{t.value + epoch_diff};
-    }
-
-
-    // NTP -> Wii U epoch.
-    utc::timestamp
-    to_utc(ntp::timestamp t)
-    {
-        return utc::timestamp{static_cast<dbl_seconds>(t) - epoch_diff};
-    }
-
-
     std::string
     ticks_to_string(OSTime wt)
     {
@@ -82,24 +71,15 @@ namespace {
         return buffer;
     }
 
-
-    std::string
-    to_string(ntp::timestamp t)
-    {
-        auto ut = to_utc(t);
-        OSTime ticks = ut.value.count() * OSTimerClockSpeed;
-        return ticks_to_string(ticks);
-    }
-
 } // namespace
 
 
 namespace core {
 
 
-    struct canceled_error : runtime_error {
-        canceled_error() : runtime_error{"Operation canceled."} {}
-    };
+    canceled_error::canceled_error() :
+        runtime_error{"Operation canceled."}
+    {}
 
 
     void
@@ -114,196 +94,369 @@ namespace core {
     sleep_for(std::chrono::milliseconds t,
               std::stop_token token)
     {
-        using clock = std::chrono::steady_clock;
-        const auto deadline = clock::now() + t;
-        while (clock::now() < deadline) {
-            check_stop(token);
-            std::this_thread::sleep_for(100ms);
-        }
+        if (!utils::wait_until(token, std::chrono::steady_clock::now() + t))
+            throw canceled_error{};
     }
 
 
     // Note: hardcoded for IPv4, the Wii U doesn't have IPv6.
-    std::pair<dbl_seconds, dbl_seconds>
-    ntp_query(std::stop_token token,
+    coro::task<ntp::clock_filter>
+    ntp_query(net::reactor& reactor,
               net::address address)
     {
-        using std::to_string;
+        ntp_session session;
+        session.add(address, cfg::burst.value, scoreboard::expected_rtt(address));
+        auto responses = co_await session.run(reactor, cfg::timeout.value);
+        auto& result = responses.front().result;
+        if (!result)
+            throw runtime_error{result.error()};
+        co_return *result;
+    }
 
-        net::socket sock{net::socket::type::udp};
-        sock.connect(address);
 
-        ntp::packet packet;
-        packet.version(4);
-        packet.mode(ntp::packet::mode_flag::client);
 
+    apply_stats
+    apply_clock_correction(dbl_seconds correction,
+                           utc::clock_anchor anchor)
+    {
+        auto to_seconds = [](OSTime t) -> dbl_seconds
+        {
+            return dbl_seconds{static_cast<double>(t) / OSTimerClockSpeed};
+        };
 
-        unsigned send_attempts = 0;
-        const unsigned max_send_attempts = 4;
+        // Note: ticks since 2000 are beyond 2^53, so only the correction goes through double.
+        const OSTime correction_ticks = std::llround(correction.count() * OSTimerClockSpeed);
+        const OSTime target = anchor.local_ticks + correction_ticks;
 
-    try_again_send:
-        // cancellation point: before sending
-        check_stop(token);
-        auto t1 = to_ntp(utc::now());
-        packet.transmit_time = t1;
-
-        auto send_status = sock.try_send(&packet, sizeof packet);
-        if (!send_status) {
-            auto& e = send_status.error();
-            if (e.code() != std::errc::not_enough_memory)
-                throw e;
-            if (++send_attempts < max_send_attempts) {
-                // cancellation point: before sleeping
-                check_stop(token);
-                std::this_thread::sleep_for(100ms);
-                goto try_again_send;
-            } else
-                throw runtime_error{"No resources for send(), too many retries!"};
-        }
+        // Where the local clock must be, right now.
+        auto projected = [&]() -> OSTime
+        {
+            return target + (OSGetSystemTime() - anchor.system_ticks);
+        };
 
+        apply_stats stats;
 
-        unsigned poll_attempts = 0;
-        const unsigned max_poll_attempts = 4;
+        OSTime before = OSGetSystemTime();
 
-    try_again_poll:
-        // cancellation point: before polling
-        check_stop(token);
-        auto readable_status = sock.try_is_readable(cfg::timeout.value);
-        if (!readable_status) {
-            // Wii U OS can only handle 16 concurrent select()/poll() calls,
-            // so we may need to try again later.
-            auto& e = readable_status.error();
-            if (e.code() != std::errc::not_enough_memory)
-                throw e;
-            if (++poll_attempts < max_poll_attempts) {
-                // cancellation point: before sleeping
-                check_stop(token);
-                std::this_thread::sleep_for(10ms);
-                goto try_again_poll;
-            } else
-                throw runtime_error{"No resources for poll(), too many retries!"};
-        }
+        nn::pdm::NotifySetTimeBeginEvent();
 
-        if (!*readable_status)
-            throw runtime_error{"Timeout reached!"};
+        OSTime ccr_start = OSGetSystemTime();
+        bool success1 = !CCRSysSetSystemTime(projected());
+        OSTime ccr_finish = OSGetSystemTime();
 
-        // Measure the arrival time as soon as possible.
-        auto t4 = to_ntp(utc::now());
+        OSTime abs_start = OSGetSystemTime();
+        bool success2 = __OSSetAbsoluteSystemTime(projected());
+        OSTime abs_finish = OSGetSystemTime();
 
-        if (sock.recv(&packet, sizeof packet) < 48)
-            throw runtime_error{"Invalid NTP response!"};
+        nn::pdm::NotifySetTimeEndEvent();
+
+        OSTime after = OSGetSystemTime();
+
+        stats.success = success1 && success2;
+        stats.ccr_duration = to_seconds(ccr_finish - ccr_start);
+        stats.abs_duration = to_seconds(abs_finish - abs_start);
+        stats.total_duration = to_seconds(after - before);
+        stats.residual = std::max(stats.ccr_duration, stats.abs_duration);
 
-        sock.close(); // close it early
+        logger::printf("CCRSysSetSystemTime() took %f ms\n",
+                       1000.0 * stats.ccr_duration.count());
+        logger::printf("__OSSetAbsoluteSystemTime() took %f ms\n",
+                       1000.0 * stats.abs_duration.count());
+        logger::printf("Total time: %f ms\n",
+                       1000.0 * stats.total_duration.count());
+
+        return stats;
+    }
 
-        auto v = packet.version();
-        if (v < 3 || v > 4)
-            throw runtime_error{"Unsupported NTP version: "s + to_string(v)};
 
-        auto m = packet.mode();
-        if (m != ntp::packet::mode_flag::server)
-            throw runtime_error{"Invalid NTP packet mode: "s + to_string(m)};
+    namespace {
 
-        auto l = packet.leap();
-        if (l == ntp::packet::leap_flag::unknown)
-            throw runtime_error{"Unknown value for leap flag."};
+        struct query_result {
+            ntp::selection    sel;
+            utc::clock_anchor anchor;
+        };
 
-        ntp::timestamp t1_received = packet.origin_time;
-        if (t1 != t1_received)
-            throw runtime_error{"NTP response mismatch: ["s
-                                + ::to_string(t1) + "] vs ["s
-                                + ::to_string(t1_received) + "]"s};
 
-        // when our request arrived at the server
-        auto t2 = packet.receive_time;
-        // when the server sent out a response
-        auto t3 = packet.transmit_time;
+        // How many servers are sampled at the same time.
+        constexpr std::size_t max_active_servers = 16;
 
-        // Zero is not a valid timestamp.
-        if (!t2 || !t3)
-            throw runtime_error{"NTP response has invalid timestamps."};
 
         /*
-         * We do all calculations in double precision to never worry about overflows. Since
-         * double precision has 53 mantissa bits, we're guaranteed to have 53 - 32 = 21
-         * fractional bits in Era 0, and 20 fractional bits in Era 1 (starting in 2036). We
-         * still have sub-microsecond resolution.
+         * How long to wait for a reply before starting another server, when a quorum is
+         * set: twice the best retransmission timeout (RFC 6298) from the round-trips seen
+         * before, within reasonable limits.
          */
-        auto d1 = static_cast<dbl_seconds>(t1);
-        auto d2 = static_cast<dbl_seconds>(t2);
-        auto d3 = static_cast<dbl_seconds>(t3);
-        auto d4 = static_cast<dbl_seconds>(t4);
+        std::chrono::milliseconds
+        stagger_delay(const std::set<net::address>& addresses)
+        {
+            std::optional<dbl_seconds> best;
+            for (auto address : addresses) {
+                auto stats = scoreboard::find(address);
+                if (!stats || stats->failures)
+                    continue;
+                dbl_seconds expected{stats->rtt + 4 * stats->rttvar};
+                best = std::min(best.value_or(expected), expected);
+            }
+            auto delay = std::chrono::duration_cast<std::chrono::milliseconds>(
+                2 * best.value_or(250ms));
+            return std::clamp<std::chrono::milliseconds>(delay, 100ms, 1s);
+        }
 
-        // Detect the wraparound that will happen at the end of Era 0.
-        constexpr dbl_seconds half_era{0x1.0p32};     // 2^32 seconds
-        constexpr dbl_seconds quarter_era{0x1.0p31};  // 2^31 seconds
-        if (d4 < d1)
-            d4 += half_era; // d4 += 2^32
-        if (d3 < d2)
-            d3 += half_era; // d3 += 2^32
 
-        dbl_seconds roundtrip = (d4 - d1) - (d3 - d2);
-        dbl_seconds latency = roundtrip / 2.0;
+        // Run the session, and select the best estimate.
+        coro::task<query_result>
+        collect(net::reactor& reactor,
+                ntp_session& session,
+                bool silent)
+        {
+            using time_utils::seconds_to_human;
+
+            // Collect all replies, in the order the servers finish.
+            std::vector<net::address> candidate_addresses;
+            std::vector<ntp::clock_filter> candidates;
+            auto responses = co_await session.run(reactor,
+                                                  cfg::timeout.value,
+                                                  cfg::quorum.value);
+            if (responses.empty()) {
+                // Probably a mistake in config, or network failure.
+                throw runtime_error{"No NTP address could be used."};
+            }
 
-        // t4 + correction = t3 + latency
-        dbl_seconds correction = d3 + latency - d4;
+            for (auto& [address, result] : responses) {
+                if (result) {
+                    candidate_addresses.push_back(address);
+                    candidates.push_back(*result);
+                    if (!silent)
+                        notify::info(notify::level::verbose,
+                                     "%s: correction = %s, delay = %s, jitter = %s",
+                                     to_string(address).data(),
+                                     seconds_to_human(result->offset(), true).data(),
+                                     seconds_to_human(result->delay()).data(),
+                                     seconds_to_human(result->jitter()).data());
+                } else {
+                    scoreboard::failure(address);
+                    if (!silent)
+                        notify::error(notify::level::verbose,
+                                      "%s: %s",
+                                      to_string(address).data(),
+                                      result.error().data());
+                }
+            }
 
-        /*
-         * If the local clock enters Era 1 ahead of NTP, we get a massive positive correction
-         * because the local clock wrapped back to zero.
-         */
-        if (correction > quarter_era) // if correcting more than 68 years forward
-            correction -= half_era;
+            if (candidates.empty()) {
+                scoreboard::store();
+                throw runtime_error{"No NTP server could be used!"};
+            }
 
-        /*
-         * If NTP enters Era 1 ahead of the local clock, we get a massive negative correction
-         * because NTP wrapped back to zero.
-         */
-        if (correction < -quarter_era) // if correcting more than 68 years backward
-            correction += half_era;
+            std::optional<ntp::selection> sel;
+            std::exception_ptr select_error;
+            try {
+                sel = ntp::select(candidates);
+            }
+            catch (...) {
+                select_error = std::current_exception();
+            }
 
-        return { correction, latency };
-    }
+            // Note: falsetickers count as failures; without a majority, nobody is blamed.
+            for (std::size_t i = 0; i < candidates.size(); ++i) {
+                if (!sel || std::ranges::find(sel->truechimers, i) != sel->truechimers.end()) {
+                    scoreboard::success(candidate_addresses[i], candidates[i]);
+                    continue;
+                }
+                scoreboard::failure(candidate_addresses[i]);
+                if (!silent)
+                    notify::error(notify::level::verbose,
+                                  "%s: discarded, disagrees with the other servers.",
+                                  to_string(candidate_addresses[i]).data());
+            }
+            scoreboard::store();
 
+            if (select_error)
+                std::rethrow_exception(select_error);
 
+            co_return query_result{ *sel, session.anchor() };
+        }
 
-    bool
-    apply_clock_correction(dbl_seconds seconds)
-    {
-        // OSTime before = OSGetSystemTime();
 
-        OSTime ticks = seconds.count() * OSTimerClockSpeed;
+        // Sample all addresses through a single socket.
+        coro::task<query_result>
+        query(net::reactor& reactor,
+              std::set<net::address> addresses,
+              unsigned burst,
+              bool silent)
+        {
+            ntp_session session;
+            session.set_max_active(max_active_servers);
+            for (auto address : addresses)
+                session.add(address, burst, scoreboard::expected_rtt(address));
+            co_return co_await collect(reactor, session, silent);
+        }
 
-        nn::pdm::NotifySetTimeBeginEvent();
 
-        // OSTime ccr_start = OSGetSystemTime();
-        bool success1 = !CCRSysSetSystemTime(OSGetTime() + ticks);
-        // OSTime ccr_finish = OSGetSystemTime();
+        // Sample the cached addresses right away, and the others as they are resolved.
+        coro::task<query_result>
+        query_pipeline(net::reactor& reactor,
+                       std::set<net::address> cached,
+                       std::vector<std::string> unresolved,
+                       net::addrinfo::hints opts,
+                       bool silent)
+        {
+            auto pipe = std::make_shared<pipeline>(cfg::burst.value);
+            pipe->session.set_max_active(max_active_servers);
+            if (cfg::quorum.value)
+                pipe->session.set_stagger(stagger_delay(cached));
+            pipe->feed({ cached.begin(), cached.end() });
+
+            if (unresolved.empty())
+                pipe->use_reserves();
+            else {
+                pipe->session.open();
+                ++pipe->feeders;
+                reactor.spawn(resolve_stage(reactor, pipe, std::move(unresolved), "123", opts,
+                                            cfg::timeout.value, executor::get(), silent));
+            }
 
-        // OSTime abs_start = OSGetSystemTime();
-        bool success2 = __OSSetAbsoluteSystemTime(OSGetTime() + ticks);
-        // OSTime abs_finish = OSGetSystemTime();
+            co_return co_await collect(reactor, pipe->session, silent);
+        }
 
-        nn::pdm::NotifySetTimeEndEvent();
 
-        // logger::printf("CCRSysSetSystemTime() took %f ms\n",
-        //                1000.0 * (ccr_finish - ccr_start) / OSTimerClockSpeed);
-        // logger::printf("__OSSetAbsoluteSystemTime() took %f ms\n",
-        //                1000.0 * (abs_finish - abs_start) / OSTimerClockSpeed);
+        // Leave the clock alone, the offset is within tolerance.
+        ntp::selection
+        tolerate(const ntp::selection& sel,
+                 bool silent)
+        {
+            using time_utils::seconds_to_human;
+
+            drift::update(sel.offset, false);
+            if (!silent)
+                notify::success(notify::level::verbose,
+                                "Tolerating clock drift (correction is only %s ± %s).",
+                                seconds_to_human(sel.offset, true).data(),
+                                seconds_to_human(sel.error).data());
+            return sel;
+        }
 
-        // OSTime after = OSGetSystemTime();
-        // logger::printf("Total time: %f ms\n",
-        //                1000.0 * (after - before) / OSTimerClockSpeed);
 
-        return success1 && success2;
-    }
+        // Apply the correction, if it's not tolerable, and feed the drift estimator.
+        ntp::selection
+        finish(std::stop_token token,
+               const ntp::selection& sel,
+               utc::clock_anchor anchor,
+               bool silent)
+        {
+            using time_utils::seconds_to_human;
 
+            if (abs(sel.offset) <= cfg::tolerance.value)
+                return tolerate(sel, silent);
 
-    void
+            // cancellation point: before modifying the clock
+            check_stop(token);
+
+            auto stats = apply_clock_correction(sel.offset, anchor);
+            if (!stats.success)
+                throw runtime_error{"Failed to set system clock!"};
+
+            drift::update(sel.offset, true);
+
+            if (!silent) {
+                notify::success(notify::level::normal,
+                                "Clock corrected by %s ± %s",
+                                seconds_to_human(sel.offset, true).data(),
+                                seconds_to_human(sel.error).data());
+                notify::info(notify::level::verbose,
+                             "Clock set in %s, residual error up to %s.",
+                             seconds_to_human(stats.total_duration).data(),
+                             seconds_to_human(stats.residual).data());
+            }
+
+            return sel;
+        }
+
+
+
+        // Check the clock against the servers, and correct it if needed.
+        coro::task<ntp::selection>
+        synchronize(net::reactor& reactor,
+                    std::stop_token token,
+                    std::vector<std::string> servers,
+                    bool silent)
+        {
+            using time_utils::seconds_to_human;
+
+            net::addrinfo::hints opts{ .type = net::socket::type::udp };
+
+            // Cached answers are used right away; expired ones are refreshed for the next
+            // sync, without waiting.
+            // Some IP addresses might be duplicated when we use "pool.ntp.org".
+            std::set<net::address> addresses;
+            std::vector<std::string> unresolved;
+            for (const auto& server : servers) {
+                if (auto cached = dns_cache::find(server, "123", opts)) {
+                    for (const auto& info : cached->results)
+                        addresses.insert(info.addr);
+                    // Note: this runs on the reactor, the lookup must not run inline.
+                    if (cached->expired)
+                        executor::enqueue(dns_cache::refresh, server, "123"s, opts);
+                    continue;
+                }
+                unresolved.push_back(server);
+            }
+
+            /*
+             * If the drift estimator says the clock should still be within tolerance, a single
+             * sample from one server is enough to confirm it. This only uses cached addresses,
+             * so it doesn't wait for DNS; the best one that is not dead is used.
+             *
+             * Note: one server is never trusted to step the clock. If it says a correction is
+             * needed, all servers are checked.
+             */
+            std::optional<net::address> best;
+            for (auto address : scoreboard::rank({ addresses.begin(), addresses.end() }))
+                if (!scoreboard::is_dead(address)) {
+                    best = address;
+                    break;
+                }
+            auto prediction = drift::predict();
+            if (best && prediction
+                && abs(prediction->offset) + prediction->error <= cfg::tolerance.value) {
+                if (!silent)
+                    notify::info(notify::level::verbose,
+                                 "Predicted correction is %s ± %s, checking only one server.",
+                                 seconds_to_human(prediction->offset, true).data(),
+                                 seconds_to_human(prediction->error).data());
+                try {
+                    std::set<net::address> first{*best};
+                    auto [sel, anchor] = co_await query(reactor, std::move(first), 1, silent);
+                    if (abs(sel.offset) <= cfg::tolerance.value)
+                        co_return tolerate(sel, silent);
+                    if (!silent)
+                        notify::info(notify::level::verbose,
+                                     "Clock is out of tolerance, checking all servers.");
+                }
+                catch (canceled_error&) {
+                    throw;
+                }
+                catch (std::exception& e) {
+                    if (!silent)
+                        notify::error(notify::level::verbose, "%s", e.what());
+                }
+            }
+
+            auto [sel, anchor] = co_await query_pipeline(reactor,
+                                                         std::move(addresses),
+                                                         std::move(unresolved),
+                                                         opts,
+                                                         silent);
+            co_return finish(token, sel, anchor, silent);
+        }
+
+    } // namespace
+
+
+    ntp::selection
     run(std::stop_token token,
         bool silent)
     {
-        using time_utils::seconds_to_human;
-
         utils::network_guard net_guard;
 
         static std::atomic<bool> executing = false;
@@ -337,121 +490,113 @@ namespace core {
         // cancellation point: after the time zone update
         check_stop(token);
 
-        thread_pool pool{static_cast<unsigned>(cfg::threads.value)};
-
         std::vector<std::string> servers = utils::split(cfg::server.value, " \t,;");
 
-        // First, resolve all the names, in parallel.
-        // Some IP addresses might be duplicated when we use "pool.ntp.org".
-        std::set<net::address> addresses;
-        {
-            // nested scope so the futures vector is destroyed early
-            using info_vec = std::vector<net::addrinfo::result>;
-            std::vector<std::future<info_vec>> futures(servers.size());
-
-            net::addrinfo::hints opts{ .type = net::socket::type::udp };
-            // Launch DNS queries asynchronously.
-            for (auto [fut, server] : std::views::zip(futures, servers))
-                fut = pool.submit(net::addrinfo::lookup, server, "123"s, opts);
-
-            // cancellation point: after submitting the DNS queries
-            check_stop(token);
-
-            // Collect all future results.
-            for (auto& fut : futures)
-                try {
-                    for (auto info : fut.get())
-                        addresses.insert(info.addr);
-                }
-                catch (std::exception& e) {
-                    if (!silent)
-                        notify::error(notify::level::verbose, "%s", e.what());
-                }
+        // DNS and NTP run as a pipeline of coroutines, on this thread.
+        net::reactor reactor;
+        std::optional<ntp::selection> sel;
+        try {
+            sel = reactor.run(token, synchronize(reactor, token, std::move(servers), silent));
         }
-
-        if (addresses.empty()) {
-            // Probably a mistake in config, or network failure.
-            throw runtime_error{"No NTP address could be used."};
+        catch (...) {
+            dns_cache::store();
+            throw;
         }
-
-        // cancellation point: before the NTP queries are submitted
-        check_stop(token);
-
-        // Launch NTP queries asynchronously.
-        std::vector<std::future<std::pair<dbl_seconds, dbl_seconds>>>
-            futures(addresses.size());
-        for (auto [fut, address] : std::views::zip(futures, addresses))
-            fut = pool.submit(ntp_query, token, address);
-
-        // cancellation point: after NTP queries are submited
-        check_stop(token);
-
-        // Collect all future results.
-        std::vector<dbl_seconds> corrections;
-        for (auto [address, fut] : std::views::zip(addresses, futures))
-            try {
-                // cancellation point: before blocking waiting for a NTP result
-                check_stop(token);
-                auto [correction, latency] = fut.get();
-                corrections.push_back(correction);
-                if (!silent)
-                    notify::info(notify::level::verbose,
-                                 "%s: correction = %s, latency = %s",
-                                 to_string(address).data(),
-                                 seconds_to_human(correction, true).data(),
-                                 seconds_to_human(latency).data());
-            }
-            catch (canceled_error&) {
-                throw;
-            }
-            catch (std::exception& e) {
-                if (!silent)
-                    notify::error(notify::level::verbose,
-                                  "%s: %s",
-                                  to_string(address).data(),
-                                  e.what());
-            }
+        // Note: the DNS answers are saved once, not every time one arrives.
+        dns_cache::store();
+
+        auto gate = net::poll_gate::get_stats();
+        logger::printf("poll(): %u calls, %u waited for a slot, %u timed out waiting,"
+                       " %u rejected with ENOMEM\n",
+                       static_cast<unsigned>(gate.polls),
+                       static_cast<unsigned>(gate.waits),
+                       static_cast<unsigned>(gate.timeouts),
+                       static_cast<unsigned>(gate.enomem));
+
+        if (!sel)
+            throw canceled_error{};
+        return *sel;
+    }
 
 
-        if (corrections.empty())
-            throw runtime_error{"No NTP server could be used!"};
+    std::string
+    local_clock_to_string()
+    {
+        return ticks_to_string(OSGetTime());
+    }
 
 
-        dbl_seconds total = std::accumulate(corrections.begin(),
-                                            corrections.end(),
-                                            dbl_seconds{0});
-        dbl_seconds avg = total / static_cast<double>(corrections.size());
+    namespace background {
 
-        if (abs(avg) <= cfg::tolerance.value) {
-            if (!silent)
-                notify::success(notify::level::verbose,
-                                "Tolerating clock drift (correction is only %s).",
-                                seconds_to_human(avg, true).data());
-            return;
-        }
+        using clock = std::chrono::steady_clock;
 
-        // cancellation point: before modifying the clock
-        check_stop(token);
 
-        if (!apply_clock_correction(avg))
-            throw runtime_error{"Failed to set system clock!"};
+        /*
+         * Adaptive poll interval, in the style of ntpd's poll exponent: the interval is
+         * 2^exp seconds. Offsets that stay within the noise (or the tolerance) push the
+         * counter up, larger ones push it down; when the counter crosses the limit, the
+         * exponent changes by one.
+         */
+        namespace poll {
+
+            constexpr int min_exp = 6;  // 64 s
+            constexpr int max_exp = 14; // ~4.5 h
+            constexpr int limit = 30;
+            constexpr double gate = 4;  // how many times the jitter is considered noise
+
+            int exp = min_exp;
+            int counter = 0;
+
+            // When the next sync is due; stays valid across stop() and run_once().
+            std::optional<clock::time_point> next_due;
+
+
+            void
+            update(const ntp::selection& sel)
+            {
+                dbl_seconds noise = std::max<dbl_seconds>(gate * sel.jitter,
+                                                          cfg::tolerance.value / 2.0);
+                if (abs(sel.offset) <= noise) {
+                    counter += exp;
+                    if (counter > limit) {
+                        counter = 0;
+                        exp = std::min(exp + 1, max_exp);
+                    }
+                } else {
+                    counter -= 2 * exp;
+                    if (counter < -limit) {
+                        counter = 0;
+                        exp = std::max(exp - 1, min_exp);
+                    }
+                }
+            }
 
-        if (!silent)
-            notify::success(notify::level::normal,
-                            "Clock corrected by %s",
-                            seconds_to_human(avg, true).data());
 
-    }
+            void
+            failed()
+            {
+                counter = 0;
+                exp = std::max(exp - 1, min_exp);
+            }
 
 
-    std::string
-    local_clock_to_string()
-    {
-        return ticks_to_string(OSGetTime());
-    }
+            // The drift estimate caps the interval to how long the clock stays in tolerance.
+            dbl_seconds
+            interval()
+            {
+                dbl_seconds result{std::ldexp(1.0, exp)};
+                double rate = std::abs(drift::ppm()) * 1e-6;
+                if (rate > 0) {
+                    dbl_seconds cap{dbl_seconds{cfg::tolerance.value}.count() / rate};
+                    result = std::min(result, cap);
+                }
+                return std::clamp(result,
+                                  dbl_seconds{std::ldexp(1.0, min_exp)},
+                                  dbl_seconds{std::ldexp(1.0, max_exp)});
+            }
 
+        } // namespace poll
 
-    namespace background {
 
         std::stop_source stopper{std::nostopstate};
 
@@ -463,30 +608,62 @@ namespace core {
         };
         std::atomic<state_t> state{state_t::none};
 
+        // Note: only used so stop() can wait for the thread with a timeout.
+        std::mutex state_mutex;
+        std::condition_variable state_changed;
 
+        // How long stop() waits for the thread to notice the stop request.
+        constexpr auto stop_timeout = 10s;
+
+
+        /*
+         * The thread syncs once after the delay, then keeps syncing at the poll interval
+         * for as long as periodic syncing is enabled. The same stop source covers all
+         * iterations.
+         */
         void
-        run()
+        start(std::chrono::milliseconds delay)
         {
             state = state_t::started;
 
             std::jthread t{
-                [](std::stop_token token)
+                [delay](std::stop_token token)
                 {
                     wups::logger::guard logger_guard;
 
+                    state_t result = state_t::finished;
                     try {
-                        // Note: we wait 5 seconds, to minimize spurious network errors.
-                        sleep_for(5s, token);
-                        core::run(token, false);
-                        state = state_t::finished;
+                        sleep_for(delay, token);
+                        for (;;) {
+                            try {
+                                poll::update(core::run(token, false));
+                            }
+                            catch (canceled_error&) {
+                                throw;
+                            }
+                            catch (std::exception& e) {
+                                notify::error(notify::level::normal, "%s", e.what());
+                                poll::failed();
+                            }
+
+                            if (!cfg::periodic.value)
+                                break;
+
+                            auto interval = poll::interval();
+                            logger::printf("Next sync in %s\n",
+                                           time_utils::seconds_to_human(interval).data());
+                            auto wait = std::chrono::round<std::chrono::milliseconds>(interval);
+                            poll::next_due = clock::now() + wait;
+                            sleep_for(wait, token);
+                        }
+                        poll::next_due.reset();
                     }
                     catch (canceled_error& e) {
-                        state = state_t::canceled;
-                    }
-                    catch (std::exception& e) {
-                        notify::error(notify::level::normal, "%s", e.what());
-                        state = state_t::finished;
+                        result = state_t::canceled;
                     }
+                    std::lock_guard guard{state_mutex};
+                    state = result;
+                    state_changed.notify_all();
                 }
             };
 
@@ -496,11 +673,28 @@ namespace core {
         }
 
 
+        void
+        run()
+        {
+            // Note: we wait 5 seconds, to minimize spurious network errors.
+            start(5s);
+        }
+
+
         void
         run_once()
         {
-            if (state != state_t::finished)
-                run();
+            if (state == state_t::finished || state == state_t::started)
+                return;
+
+            // A periodic schedule interrupted by stop() resumes where it was.
+            std::chrono::milliseconds delay = 5s;
+            if (poll::next_due) {
+                auto remaining = std::chrono::ceil<std::chrono::milliseconds>(*poll::next_due
+                                                                              - clock::now());
+                delay = std::max(delay, remaining);
+            }
+            start(delay);
         }
 
 
@@ -510,13 +704,14 @@ namespace core {
             if (state == state_t::started) {
                 stopper.request_stop();
 
-                // Wait up to ~10 seconds for the thread to flag it stopped running.
-                unsigned max_tries = 100;
-                do {
-                    std::this_thread::sleep_for(100ms);
-                } while ((state == state_t::started) && --max_tries);
-
-                if (state == state_t::started)
+                /*
+                 * Every wait in the thread reacts to the stop request, and the HTTP requests
+                 * have their own timeout, so this should return quickly; but never block the
+                 * plugin on it.
+                 */
+                std::unique_lock lock{state_mutex};
+                if (!state_changed.wait_for(lock, stop_timeout,
+                                            [] { return state != state_t::started; }))
                     logger::printf("WARNING: Background thread did not stop!\n");
 
                 stopper = std::stop_source{std::nostopstate};
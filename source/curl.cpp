@@ -114,6 +114,13 @@ namespace curl {
     }
 
 
+    void
+    handle::setopt(CURLoption option, long arg)
+    {
+        check(curl_easy_setopt(h, option, arg));
+    }
+
+
     void
     handle::setopt(CURLoption option, const std::string& arg)
     {
@@ -130,6 +137,13 @@ namespace curl {
     }
 
 
+    void
+    handle::set_timeout(std::chrono::milliseconds timeout)
+    {
+        setopt(CURLOPT_TIMEOUT_MS, static_cast<long>(timeout.count()));
+    }
+
+
     void
     handle::set_url(const std::string& url)
     {
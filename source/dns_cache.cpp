@@ -0,0 +1,338 @@
+/*
+ * Wii U Time Sync - A NTP client plugin for the Wii U.
+ *
+ * Copyright (C) 2025  Daniel K. O.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <algorithm>            // clamp()
+#include <charconv>             // from_chars()
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <utility>              // move()
+
+#include <arpa/inet.h>          // inet_pton()
+#include <coreinit/time.h>      // OSGetSystemTime()
+#include <nn/ac.h>
+
+#include <wupsxx/logger.hpp>
+#include <wupsxx/storage.hpp>
+
+#include "dns_cache.hpp"
+
+#include "net/resolver.hpp"
+
+
+namespace logger = wups::logger;
+
+
+namespace dns_cache {
+
+    namespace {
+
+        /*
+         * Times are in seconds of system time (since boot), so they don't jump when the
+         * clock is corrected.
+         */
+        struct record {
+            std::vector<result> results;
+            double expires = 0;
+            double discard = 0; // not even used as stale after this
+        };
+
+
+        std::mutex mutex;
+
+        // Note: the key is "name service type flags", names can't have spaces.
+        std::map<std::string, record> records;
+
+        // Set when records change, so store() only writes to storage if needed.
+        bool dirty = false;
+
+
+        int
+        encode(const std::optional<net::socket::type>& t)
+            noexcept
+        {
+            if (!t)
+                return 0;
+            return *t == net::socket::type::tcp ? 1 : 2;
+        }
+
+
+        std::optional<net::socket::type>
+        decode_type(int t)
+            noexcept
+        {
+            switch (t) {
+                case 1:
+                    return net::socket::type::tcp;
+                case 2:
+                    return net::socket::type::udp;
+                default:
+                    return {};
+            }
+        }
+
+
+        std::string
+        make_key(const std::string& name,
+                 const std::string& service,
+                 const hints& opts)
+        {
+            int flags = (opts.canon_name   ? 1 : 0)
+                      | (opts.numeric_host ? 2 : 0)
+                      | (opts.passive      ? 4 : 0);
+            return name + " " + service + " " + std::to_string(encode(opts.type))
+                + " " + std::to_string(flags);
+        }
+
+
+        double
+        now()
+        {
+            return static_cast<double>(OSGetSystemTime()) / OSTimerClockSpeed;
+        }
+
+
+        // The DNS servers assigned by the current network connection.
+        std::vector<net::address>
+        system_servers()
+        {
+            std::vector<net::address> result;
+            std::uint32_t ip = 0;
+            if (NNResult_IsSuccess(ACGetAssignedPrimaryDns(&ip)) && ip)
+                result.emplace_back(ip, 53);
+            ip = 0;
+            if (NNResult_IsSuccess(ACGetAssignedSecondaryDns(&ip)) && ip)
+                result.emplace_back(ip, 53);
+            return result;
+        }
+
+    } // namespace
+
+
+    void
+    load()
+        noexcept
+    {
+        std::lock_guard guard{mutex};
+        try {
+            records.clear();
+            dirty = false;
+            std::string data;
+            if (!wups::load("dns_cache", data))
+                return;
+
+            // Note: how long the console was off is unknown, so loaded records are
+            // considered expired; they're still used until their stale time runs out.
+            double t = now();
+            std::istringstream in{data};
+            std::string line;
+            while (std::getline(in, line)) {
+                std::istringstream fields{line};
+                std::string name, service;
+                int type, flags;
+                record rec;
+                double usable;
+                std::size_t count;
+                if (!(fields >> name >> service >> type >> flags >> usable >> count))
+                    continue;
+                // Note: older versions stored the UTC expiration time here; the clamp
+                // turns it into the maximum stale time.
+                usable = std::clamp<double>(usable, 0, max_stale.count());
+                rec.expires = t;
+                rec.discard = t + usable;
+                for (std::size_t i = 0; i < count; ++i) {
+                    int rtype;
+                    result r;
+                    std::string canon;
+                    if (!(fields >> rtype >> r.addr.ip >> r.addr.port >> canon))
+                        break;
+                    r.type = decode_type(rtype).value_or(net::socket::type::udp);
+                    if (canon != "-")
+                        r.canon_name = std::move(canon);
+                    rec.results.push_back(std::move(r));
+                }
+                if (rec.results.size() != count)
+                    continue;
+                auto key = name + " " + service + " " + std::to_string(type)
+                    + " " + std::to_string(flags);
+                records[key] = std::move(rec);
+            }
+        }
+        catch (std::exception& e) {
+            logger::printf("Error in dns_cache::load(): %s\n", e.what());
+            records.clear();
+        }
+    }
+
+
+    std::optional<entry>
+    find(const std::string& name,
+         const std::string& service,
+         const hints& opts)
+    {
+        std::lock_guard guard{mutex};
+        auto it = records.find(make_key(name, service, opts));
+        if (it == records.end())
+            return {};
+        const auto& rec = it->second;
+        double t = now();
+        if (t > rec.discard)
+            return {};
+        return entry{rec.results, t >= rec.expires};
+    }
+
+
+    std::vector<result>
+    refresh(const std::string& name,
+            const std::string& service,
+            const hints& opts)
+    {
+        auto results = net::addrinfo::lookup(name, service, opts);
+        insert(name, service, opts, results);
+        return results;
+    }
+
+
+    coro::task<std::vector<std::optional<std::vector<result>>>>
+    resolve(net::reactor& reactor,
+            std::vector<std::string> names,
+            std::string service,
+            hints opts,
+            std::chrono::milliseconds timeout,
+            answer_callback on_answer)
+    {
+        std::vector<std::optional<std::vector<result>>> answers(names.size());
+
+        auto deliver = [&](std::size_t i, std::optional<std::vector<result>> answer)
+        {
+            answers[i] = std::move(answer);
+            if (on_answer)
+                on_answer(names[i], answers[i]);
+        };
+
+        // Only plain lookups are done natively; anything fancier is left to getaddrinfo().
+        net::port_t port = 0;
+        auto [end, ec] = std::from_chars(service.data(), service.data() + service.size(), port);
+        auto servers = system_servers();
+        if (ec != std::errc{} || end != service.data() + service.size()
+            || opts.canon_name || opts.numeric_host || opts.passive
+            || servers.empty()) {
+            for (std::size_t i = 0; i < names.size(); ++i)
+                deliver(i, {});
+            co_return answers;
+        }
+
+        net::resolver res{std::move(servers)};
+        res.set_max_in_flight(max_in_flight);
+        std::vector<std::size_t> queried;
+        for (std::size_t i = 0; i < names.size(); ++i) {
+            in_addr numeric;
+            if (inet_pton(AF_INET, names[i].c_str(), &numeric) == 1) {
+                deliver(i, {}); // not a name
+                continue;
+            }
+            res.add(names[i]);
+            queried.push_back(i);
+        }
+
+        res.set_callback([&](std::size_t j, const net::resolver::outcome& outcome)
+        {
+            auto i = queried[j];
+            if (!outcome) {
+                logger::printf("DNS query for \"%s\" failed: %s\n",
+                               names[i].c_str(), outcome.error().c_str());
+                deliver(i, {});
+                return;
+            }
+            std::vector<result> results;
+            for (auto ip : outcome->addresses)
+                results.push_back({ opts.type.value_or(net::socket::type::udp),
+                                    net::address{ip, port},
+                                    {} });
+            insert(names[i], service, opts, results, outcome->ttl);
+            deliver(i, std::move(results));
+        });
+
+        if (!queried.empty())
+            co_await res.run(reactor, timeout);
+
+        co_return answers;
+    }
+
+
+    std::vector<result>
+    lookup(const std::string& name,
+           const std::string& service,
+           const hints& opts)
+    {
+        auto cached = find(name, service, opts);
+        if (cached && !cached->expired)
+            return std::move(cached->results);
+        return refresh(name, service, opts);
+    }
+
+
+    void
+    insert(const std::string& name,
+           const std::string& service,
+           const hints& opts,
+           const std::vector<result>& results,
+           std::chrono::seconds ttl)
+    {
+        if (results.empty())
+            return;
+
+        std::lock_guard guard{mutex};
+        auto& rec = records[make_key(name, service, opts)];
+        rec.results = results;
+        rec.expires = now() + ttl.count();
+        rec.discard = rec.expires + max_stale.count();
+        dirty = true;
+    }
+
+
+    /*
+     * Stored as one line per record:
+     *     name service type flags usable count [type ip port canon]...
+     * where usable is how many seconds the record can still be used as stale, and canon
+     * is "-" when absent. Records too old to be used are dropped.
+     */
+    void
+    store()
+    {
+        std::lock_guard guard{mutex};
+        double t = now();
+        if (std::erase_if(records, [t](const auto& kv) { return t > kv.second.discard; }))
+            dirty = true;
+        if (!dirty)
+            return;
+
+        std::ostringstream out;
+        out.precision(17);
+        for (const auto& [key, rec] : records) {
+            out << key << ' ' << rec.discard - t << ' ' << rec.results.size();
+            for (const auto& r : rec.results)
+                out << ' ' << encode(r.type)
+                    << ' ' << r.addr.ip
+                    << ' ' << r.addr.port
+                    << ' ' << r.canon_name.value_or("-");
+            out << '\n';
+        }
+
+        logger::guard lguard;
+        try {
+            wups::store("dns_cache", out.str());
+            wups::save();
+            dirty = false;
+        }
+        catch (std::exception& e) {
+            logger::printf("Error in dns_cache::store(): %s\n", e.what());
+        }
+    }
+
+} // namespace dns_cache
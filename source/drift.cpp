@@ -0,0 +1,173 @@
+/*
+ * Wii U Time Sync - A NTP client plugin for the Wii U.
+ *
+ * Copyright (C) 2025  Daniel K. O.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <algorithm>            // max()
+#include <cmath>                // abs(), sqrt()
+#include <mutex>
+
+#include <wupsxx/logger.hpp>
+#include <wupsxx/storage.hpp>
+
+#include "drift.hpp"
+
+#include "utc.hpp"
+
+
+using namespace std::literals;
+
+namespace logger = wups::logger;
+
+
+namespace drift {
+
+    namespace {
+
+        // Intervals shorter than this are too noisy to estimate the frequency.
+        constexpr dbl_seconds min_interval = 10min;
+
+        // Anything beyond this is not drift, the clock was changed by something else.
+        constexpr double max_rate = 500e-6;
+
+        // Even a perfectly stable estimate is not trusted beyond this.
+        constexpr double min_wander = 1e-6;
+
+        // How many updates are needed before making predictions.
+        constexpr int min_count = 3;
+
+        // The loop averages the first updates, then becomes an exponential average.
+        constexpr double min_gain = 0.25;
+
+
+        std::mutex mutex;
+
+        double freq = 0;     // seconds of correction, per second
+        double wander = 0;   // RMS deviation of the measured rates from freq
+        double residual = 0; // offset left in the clock at the last update, in seconds
+        double last = 0;     // UTC seconds since 2000, at the last update; zero if unknown
+        int    count = 0;    // how many rates were measured
+
+
+        void
+        store()
+        {
+            logger::guard guard;
+            try {
+                wups::store("drift_freq", freq);
+                wups::store("drift_wander", wander);
+                wups::store("drift_residual", residual);
+                wups::store("drift_last", last);
+                wups::store("drift_count", count);
+                wups::save();
+            }
+            catch (std::exception& e) {
+                logger::printf("Error in drift::store(): %s\n", e.what());
+            }
+        }
+
+
+        void
+        reset()
+        {
+            freq = wander = residual = last = 0;
+            count = 0;
+        }
+
+    } // namespace
+
+
+    void
+    load()
+        noexcept
+    {
+        std::lock_guard guard{mutex};
+        try {
+            wups::load("drift_freq", freq);
+            wups::load("drift_wander", wander);
+            wups::load("drift_residual", residual);
+            wups::load("drift_last", last);
+            wups::load("drift_count", count);
+        }
+        catch (std::exception& e) {
+            logger::printf("Error in drift::load(): %s\n", e.what());
+            reset();
+        }
+    }
+
+
+    std::optional<prediction>
+    predict()
+    {
+        std::lock_guard guard{mutex};
+
+        if (count < min_count || !last)
+            return {};
+
+        double elapsed = utc::now().value.count() - last;
+        if (elapsed < 0)
+            return {}; // the clock went backwards, can't predict anything
+
+        return prediction{
+            dbl_seconds{residual + freq * elapsed},
+            dbl_seconds{std::max(wander, min_wander) * elapsed}
+        };
+    }
+
+
+    void
+    update(dbl_seconds measured,
+           bool corrected)
+    {
+        std::lock_guard guard{mutex};
+
+        double now = utc::now().value.count();
+
+        if (last) {
+            double elapsed = now - last;
+            if (elapsed < min_interval.count()) {
+                // Too soon to learn anything; only move the baseline if the clock changed.
+                if (corrected) {
+                    residual = 0;
+                    last = now;
+                    store();
+                }
+                return;
+            }
+
+            double rate = (measured.count() - residual) / elapsed;
+            if (std::abs(rate) > max_rate) {
+                logger::printf("Discarding drift estimate, rate was %f ppm.\n", rate * 1e6);
+                reset();
+            } else {
+                if (++count == 1)
+                    freq = rate;
+                else {
+                    double gain = std::max(1.0 / count, min_gain);
+                    double dev = rate - freq;
+                    freq += gain * dev;
+                    wander = std::sqrt((1 - gain) * wander * wander + gain * dev * dev);
+                }
+                logger::printf("Drift estimate: %f ppm (wander %f ppm)\n",
+                               freq * 1e6, wander * 1e6);
+            }
+        }
+
+        residual = corrected ? 0 : measured.count();
+        last = now;
+        store();
+    }
+
+
+    double
+    ppm()
+        noexcept
+    {
+        std::lock_guard guard{mutex};
+        return freq * 1e6;
+    }
+
+} // namespace drift
@@ -0,0 +1,86 @@
+/*
+ * Wii U Time Sync - A NTP client plugin for the Wii U.
+ *
+ * Copyright (C) 2025  Daniel K. O.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <algorithm>            // max()
+#include <optional>
+#include <stdexcept>            // logic_error
+
+#include <wupsxx/logger.hpp>
+
+#include "executor.hpp"
+
+#include "cfg.hpp"
+
+
+namespace logger = wups::logger;
+
+
+namespace executor {
+
+    namespace {
+
+        std::optional<thread_pool> pool;
+
+
+        /*
+         * There's always at least one worker, so the menu never blocks on a sync. With
+         * cfg::threads set to 0, tasks submitted by that worker run sequentially, inline.
+         */
+        unsigned
+        wanted_size()
+        {
+            return std::max(1, cfg::threads.value);
+        }
+
+    } // namespace
+
+
+    void
+    initialize()
+    {
+        pool.emplace(wanted_size());
+    }
+
+
+    void
+    finalize()
+    {
+        pool.reset();
+        // Don't leave the recycled task states behind when the plugin is unloaded.
+        task_state_pools::drain_all();
+    }
+
+
+    void
+    update_size()
+    {
+        if (pool)
+            pool->resize(wanted_size());
+    }
+
+
+    void
+    release_workers()
+    {
+        if (!pool)
+            return;
+        // A worker stuck in getaddrinfo() must not hang the application exit.
+        if (auto n = pool->release_workers(std::chrono::seconds{1}))
+            logger::printf("Detached %zu stuck worker thread(s).\n", n);
+    }
+
+
+    thread_pool&
+    get()
+    {
+        if (!pool)
+            throw std::logic_error{"Executor is not initialized."};
+        return *pool;
+    }
+
+} // namespace executor
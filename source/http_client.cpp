@@ -11,6 +11,9 @@
 #include "curl.hpp"
 
 
+using namespace std::literals;
+
+
 namespace http {
 
     std::string
@@ -22,6 +25,8 @@ namespace http {
 
         handle.set_useragent(PLUGIN_NAME "/" PLUGIN_VERSION " (Wii U; Aroma)");
         handle.set_followlocation(true);
+        // Note: curl can't see stop requests, so it needs its own limit.
+        handle.set_timeout(10s);
         handle.set_url(url);
 
         handle.perform();
@@ -13,6 +13,7 @@
 
 #include "cfg.hpp"
 #include "core.hpp"
+#include "executor.hpp"
 #include "notify.hpp"
 
 
@@ -33,19 +34,22 @@ INITIALIZE_PLUGIN()
     wups::logger::guard guard;
     notify::initialize();
     cfg::init();
+    executor::initialize();
 }
 
 
 DEINITIALIZE_PLUGIN()
 {
     core::background::stop();
+    executor::finalize();
     notify::finalize();
 }
 
 
 ON_APPLICATION_START()
 {
-    if (cfg::sync_on_boot.value)
+    // Note: stop() is called on every app switch, so a periodic schedule must resume here.
+    if (cfg::sync_on_boot.value || cfg::periodic.value)
         core::background::run_once();
 }
 
@@ -53,4 +57,5 @@ ON_APPLICATION_START()
 ON_APPLICATION_REQUESTS_EXIT()
 {
     core::background::stop();
+    executor::release_workers();
 }
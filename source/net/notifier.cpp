@@ -0,0 +1,62 @@
+/*
+ * Wii U Time Sync - A NTP client plugin for the Wii U.
+ *
+ * Copyright (C) 2025  Daniel K. O.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <array>
+#include <cstdint>
+
+#include "net/notifier.hpp"
+
+
+namespace net {
+
+    namespace {
+
+        constexpr ipv4_t loopback = 0x7f000001; // 127.0.0.1
+
+    } // namespace
+
+
+    notifier::notifier() :
+        sock{socket::type::udp}
+    {
+        sock.bind({loopback, 0});
+        addr = sock.getsockname();
+    }
+
+
+    void
+    notifier::notify()
+        noexcept
+    {
+        // Only the first notification needs a datagram, until the waiter consumes it.
+        if (pending.exchange(true))
+            return;
+        std::uint8_t byte = 0;
+        // Note: if this fails, the waiter still sees `pending` once its wait times out.
+        (void) sock.try_sendto(&byte, sizeof byte, addr, socket::msg_flags::dontwait);
+    }
+
+
+    coro::task<bool>
+    notifier::wait(reactor& r,
+                   reactor::clock::time_point deadline)
+    {
+        for (;;) {
+            // Discard the datagrams already received, before checking the flag.
+            std::array<std::uint8_t, 16> buf;
+            while (sock.try_recvfrom(buf.data(), buf.size(), socket::msg_flags::dontwait))
+                ;
+            if (pending.exchange(false))
+                co_return true;
+            auto events = co_await r.wait(sock, socket::poll_flags::in, deadline);
+            if (events == socket::poll_flags::none)
+                co_return pending.exchange(false);
+        }
+    }
+
+} // namespace net
@@ -0,0 +1,96 @@
+/*
+ * Wii U Time Sync - A NTP client plugin for the Wii U.
+ *
+ * Copyright (C) 2025  Daniel K. O.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <algorithm>            // max()
+#include <atomic>
+#include <cerrno>
+#include <semaphore>
+
+#include "net/poll_gate.hpp"
+
+
+namespace net::poll_gate {
+
+    namespace {
+
+        std::counting_semaphore<max_slots> slots{max_slots};
+
+        // Note: 32 bits, so they're lock-free on the console.
+        std::atomic<std::uint32_t> num_polls = 0;
+        std::atomic<std::uint32_t> num_waits = 0;
+        std::atomic<std::uint32_t> num_timeouts = 0;
+        std::atomic<std::uint32_t> num_enomem = 0;
+
+
+        // Takes a slot, and returns the timeout left for poll(); negative if none was free.
+        std::chrono::milliseconds
+        acquire(std::chrono::milliseconds timeout)
+            noexcept
+        {
+            if (slots.try_acquire())
+                return timeout;
+
+            ++num_waits;
+
+            // A negative timeout means "wait forever", like in poll().
+            if (timeout < std::chrono::milliseconds{0}) {
+                slots.acquire();
+                return timeout;
+            }
+
+            using clock = std::chrono::steady_clock;
+            auto start = clock::now();
+            if (!slots.try_acquire_for(timeout))
+                return std::chrono::milliseconds{-1};
+            auto waited = std::chrono::ceil<std::chrono::milliseconds>(clock::now() - start);
+            return std::max(timeout - waited, std::chrono::milliseconds{0});
+        }
+
+    } // namespace
+
+
+    int
+    poll(pollfd* fds,
+         nfds_t count,
+         std::chrono::milliseconds timeout)
+        noexcept
+    {
+        bool forever = timeout < std::chrono::milliseconds{0};
+        auto remaining = acquire(timeout);
+        if (!forever && remaining < std::chrono::milliseconds{0}) {
+            ++num_timeouts;
+            for (nfds_t i = 0; i < count; ++i)
+                fds[i].revents = 0;
+            return 0;
+        }
+
+        ++num_polls;
+        int status = ::poll(fds, count, remaining.count());
+        int saved_errno = errno;
+        slots.release();
+
+        if (status == -1 && saved_errno == ENOMEM)
+            ++num_enomem;
+        errno = saved_errno;
+        return status;
+    }
+
+
+    stats
+    get_stats()
+        noexcept
+    {
+        return {
+            num_polls.load(),
+            num_waits.load(),
+            num_timeouts.load(),
+            num_enomem.load(),
+        };
+    }
+
+} // namespace net::poll_gate
@@ -0,0 +1,101 @@
+/*
+ * Wii U Time Sync - A NTP client plugin for the Wii U.
+ *
+ * Copyright (C) 2025  Daniel K. O.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <cerrno>
+#include <new>                  // bad_alloc
+
+#include "net/poller.hpp"
+
+#include "net/poll_gate.hpp"
+
+
+namespace net {
+
+    std::size_t
+    poller::add(const socket& s,
+                poll_flags events)
+    {
+        fds.push_back({ s.native_handle(), static_cast<short>(events), 0 });
+        return fds.size() - 1;
+    }
+
+
+    void
+    poller::clear()
+        noexcept
+    {
+        fds.clear();
+    }
+
+
+    bool
+    poller::empty()
+        const noexcept
+    {
+        return fds.empty();
+    }
+
+
+    std::size_t
+    poller::size()
+        const noexcept
+    {
+        return fds.size();
+    }
+
+
+    std::vector<poller::ready>
+    poller::wait()
+    {
+        auto status = try_wait();
+        if (!status)
+            throw status.error();
+        return std::move(*status);
+    }
+
+
+    std::vector<poller::ready>
+    poller::wait(std::chrono::milliseconds timeout)
+    {
+        auto status = try_wait(timeout);
+        if (!status)
+            throw status.error();
+        return std::move(*status);
+    }
+
+
+    std::expected<std::vector<poller::ready>, error>
+    poller::try_wait()
+        noexcept
+    {
+        return try_wait(std::chrono::milliseconds{-1});
+    }
+
+
+    std::expected<std::vector<poller::ready>, error>
+    poller::try_wait(std::chrono::milliseconds timeout)
+        noexcept
+    {
+        int status = poll_gate::poll(fds.data(), fds.size(), timeout);
+        if (status == -1)
+            return std::unexpected{error{errno}};
+
+        try {
+            std::vector<ready> result;
+            result.reserve(status);
+            for (std::size_t i = 0; i < fds.size(); ++i)
+                if (fds[i].revents)
+                    result.emplace_back(i, poll_flags{fds[i].revents});
+            return result;
+        }
+        catch (std::bad_alloc&) {
+            return std::unexpected{error{ENOMEM}};
+        }
+    }
+
+} // namespace net
@@ -0,0 +1,235 @@
+/*
+ * Wii U Time Sync - A NTP client plugin for the Wii U.
+ *
+ * Copyright (C) 2025  Daniel K. O.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <algorithm>            // min(), ranges::find()
+
+#include "net/reactor.hpp"
+
+#include "net/error.hpp"
+#include "utils.hpp"
+
+
+using namespace std::literals;
+
+
+namespace net {
+
+    namespace {
+
+        // How long to back off when poll() fails with ENOMEM.
+        constexpr std::chrono::milliseconds enomem_delay = 10ms;
+
+    } // namespace
+
+
+    reactor::wait_op::wait_op(reactor& owner,
+                              const socket* sock,
+                              socket::poll_flags events,
+                              clock::time_point deadline)
+        noexcept :
+        owner(owner),
+        sock{sock},
+        events{events},
+        deadline{deadline}
+    {}
+
+
+    bool
+    reactor::wait_op::await_ready()
+        const noexcept
+    {
+        return false;
+    }
+
+
+    void
+    reactor::wait_op::await_suspend(std::coroutine_handle<> h)
+    {
+        handle = h;
+        owner.waiting.push_back(this);
+    }
+
+
+    socket::poll_flags
+    reactor::wait_op::await_resume()
+        const noexcept
+    {
+        return revents;
+    }
+
+
+    reactor::wait_op
+    reactor::wait(const socket& s,
+                  socket::poll_flags events,
+                  clock::time_point deadline)
+        noexcept
+    {
+        return wait_op{*this, &s, events, deadline};
+    }
+
+
+    reactor::wait_op
+    reactor::sleep_until(clock::time_point deadline)
+        noexcept
+    {
+        return wait_op{*this, nullptr, socket::poll_flags::none, deadline};
+    }
+
+
+    void
+    reactor::wake(wait_op& op)
+        noexcept
+    {
+        op.deadline = clock::time_point::min();
+    }
+
+
+    namespace {
+
+        bool
+        would_block(const error& e)
+            noexcept
+        {
+            return e.code() == std::errc::operation_would_block
+                || e.code() == std::errc::resource_unavailable_try_again
+                || e.code() == std::errc::not_enough_memory;
+        }
+
+    } // namespace
+
+
+    coro::task<std::optional<std::size_t>>
+    reactor::sendto(socket& s,
+                    const void* buf,
+                    std::size_t len,
+                    address dst,
+                    clock::time_point deadline)
+    {
+        for (;;) {
+            auto status = s.try_sendto(buf, len, dst, socket::msg_flags::dontwait);
+            if (status)
+                co_return *status;
+            if (!would_block(status.error()))
+                throw status.error();
+            // Note: ENOMEM means the network stack is out of buffers, just try again later.
+            auto ready = co_await (status.error().code() == std::errc::not_enough_memory
+                                   ? sleep_until(std::min(deadline, clock::now() + 100ms))
+                                   : wait(s, socket::poll_flags::out, deadline));
+            if (ready == socket::poll_flags::none && clock::now() >= deadline)
+                co_return std::nullopt;
+        }
+    }
+
+
+    coro::task<std::optional<std::pair<std::size_t, address>>>
+    reactor::recvfrom(socket& s,
+                      void* buf,
+                      std::size_t len,
+                      clock::time_point deadline)
+    {
+        for (;;) {
+            auto status = s.try_recvfrom(buf, len, socket::msg_flags::dontwait);
+            if (status)
+                co_return *status;
+            if (!would_block(status.error()))
+                throw status.error();
+            auto ready = co_await wait(s, socket::poll_flags::in, deadline);
+            if (ready == socket::poll_flags::none)
+                co_return std::nullopt;
+        }
+    }
+
+
+    void
+    reactor::spawn(coro::task<void> t)
+    {
+        t.start();
+        spawned.push_back(std::move(t));
+    }
+
+
+    void
+    reactor::step(std::stop_token token)
+    {
+        auto now = clock::now();
+        auto next = clock::time_point::max();
+
+        std::vector<wait_op*> finished;
+        std::vector<wait_op*> polled; // indexed like the poller
+        poller sockets;
+        for (auto op : waiting) {
+            if (op->deadline <= now) {
+                finished.push_back(op);
+                continue;
+            }
+            next = std::min(next, op->deadline);
+            if (op->sock) {
+                sockets.add(*op->sock, op->events);
+                polled.push_back(op);
+            }
+        }
+
+        // Only block if nobody is ready to run.
+        if (finished.empty()) {
+            if (sockets.empty()) {
+                // Note: timers alone don't need polling, this wakes up on a stop request.
+                if (next == clock::time_point::max())
+                    next = now + max_wait;
+                utils::wait_until(token, next);
+            }
+            else {
+                auto timeout = std::chrono::ceil<std::chrono::milliseconds>(
+                                   std::min(next - now, clock::duration{max_wait}));
+                auto ready = sockets.try_wait(timeout);
+                if (ready) {
+                    for (auto [idx, events] : *ready) {
+                        polled[idx]->revents = events;
+                        finished.push_back(polled[idx]);
+                    }
+                } else if (ready.error().code() == std::errc::not_enough_memory) {
+                    // Note: other processes may still use up the OS limit; try again later.
+                    utils::wait_until(token, std::min(next, clock::now() + enomem_delay));
+                } else
+                    throw ready.error();
+            }
+            now = clock::now();
+            for (auto op : waiting)
+                if (op->deadline <= now && std::ranges::find(finished, op) == finished.end())
+                    finished.push_back(op);
+        }
+
+        std::erase_if(waiting,
+                      [&finished](wait_op* op)
+                      {
+                          return std::ranges::find(finished, op) != finished.end();
+                      });
+
+        for (auto op : finished)
+            op->handle.resume();
+
+        // Collect finished background tasks, and propagate their errors.
+        for (auto it = spawned.begin(); it != spawned.end();) {
+            if (it->done()) {
+                auto t = std::move(*it);
+                it = spawned.erase(it);
+                t.result();
+            } else
+                ++it;
+        }
+    }
+
+
+    void
+    reactor::cancel()
+        noexcept
+    {
+        waiting.clear();
+        spawned.clear();
+    }
+
+} // namespace net
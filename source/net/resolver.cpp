@@ -0,0 +1,426 @@
+/*
+ * Wii U Time Sync - A NTP client plugin for the Wii U.
+ *
+ * Copyright (C) 2025  Daniel K. O.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <algorithm>            // equal(), min(), ranges::any_of(), ranges::count_if(),
+                                // ranges::find(), ranges::find_if()
+#include <array>
+#include <cctype>               // tolower()
+#include <exception>
+#include <mutex>
+#include <optional>
+#include <random>
+#include <string_view>
+#include <utility>              // move()
+
+#include <wupsxx/logger.hpp>
+
+#include "net/resolver.hpp"
+
+
+using namespace std::literals;
+
+namespace logger = wups::logger;
+
+
+namespace net {
+
+    namespace {
+
+        constexpr std::uint16_t type_a = 1;
+        constexpr std::uint16_t class_in = 1;
+
+        constexpr std::uint8_t rcode_nxdomain = 3;
+
+        // Classic DNS over UDP is limited to 512 bytes, without EDNS.
+        constexpr std::size_t max_message = 512;
+
+
+        void
+        put16(std::vector<std::uint8_t>& out,
+              std::uint16_t value)
+        {
+            out.push_back(value >> 8);
+            out.push_back(value & 0xff);
+        }
+
+
+        std::uint16_t
+        get16(const std::uint8_t* p)
+            noexcept
+        {
+            return (p[0] << 8) | p[1];
+        }
+
+
+        std::uint32_t
+        get32(const std::uint8_t* p)
+            noexcept
+        {
+            return (std::uint32_t{get16(p)} << 16) | get16(p + 2);
+        }
+
+
+        // Returns nothing if the name can't be encoded.
+        std::optional<std::vector<std::uint8_t>>
+        make_query(const std::string& name,
+                   std::uint16_t id)
+        {
+            std::vector<std::uint8_t> msg;
+            put16(msg, id);
+            put16(msg, 0x0100); // standard query, recursion desired
+            put16(msg, 1);      // questions
+            put16(msg, 0);      // answers
+            put16(msg, 0);      // authority records
+            put16(msg, 0);      // additional records
+
+            std::string_view rest = name;
+            if (rest.ends_with('.'))
+                rest.remove_suffix(1);
+            if (rest.empty() || rest.size() > 253)
+                return {};
+            while (!rest.empty()) {
+                auto dot = rest.find('.');
+                auto label = rest.substr(0, dot);
+                if (label.empty() || label.size() > 63)
+                    return {};
+                msg.push_back(label.size());
+                msg.insert(msg.end(), label.begin(), label.end());
+                rest = dot == std::string_view::npos ? ""sv : rest.substr(dot + 1);
+            }
+            msg.push_back(0);
+
+            put16(msg, type_a);
+            put16(msg, class_in);
+            return msg;
+        }
+
+
+        /*
+         * Random IDs make it harder for an off-path attacker to forge replies (RFC 5452).
+         * The engine is seeded once; the clock is mixed in, in case random_device is not
+         * available.
+         */
+        std::uint16_t
+        random_id()
+        {
+            static std::mutex mutex;
+            static std::mt19937 engine = []
+            {
+                std::seed_seq::result_type dev = 0;
+                try {
+                    dev = std::random_device{}();
+                }
+                catch (std::exception&) {}
+                auto t = resolver::clock::now().time_since_epoch().count();
+                std::seed_seq seq{
+                    dev,
+                    static_cast<std::seed_seq::result_type>(t),
+                    static_cast<std::seed_seq::result_type>(t >> 32),
+                };
+                return std::mt19937{seq};
+            }();
+
+            std::lock_guard guard{mutex};
+            return std::uniform_int_distribution<std::uint16_t>{}(engine);
+        }
+
+
+        /*
+         * True if the reply has the same single question as the query: same name (ignoring
+         * case), type and class.
+         */
+        bool
+        same_question(const std::uint8_t* data,
+                      std::size_t size,
+                      const std::vector<std::uint8_t>& query)
+            noexcept
+        {
+            if (size < query.size() || get16(data + 4) != 1)
+                return false;
+            // Note: length bytes are below 64, so tolower() only changes the letters.
+            return std::equal(query.begin() + 12, query.end(),
+                              data + 12,
+                              [](std::uint8_t a, std::uint8_t b)
+                              {
+                                  return std::tolower(a) == std::tolower(b);
+                              });
+        }
+
+
+        // Returns the position after the name, or nothing if it's malformed.
+        std::optional<std::size_t>
+        skip_name(const std::uint8_t* data,
+                  std::size_t size,
+                  std::size_t pos)
+            noexcept
+        {
+            while (pos < size) {
+                std::uint8_t len = data[pos];
+                if (len == 0)
+                    return pos + 1;
+                if ((len & 0xc0) == 0xc0) // compression pointer ends the name
+                    return pos + 2 <= size ? std::optional{pos + 2} : std::nullopt;
+                if (len & 0xc0)
+                    return {};
+                pos += 1 + len;
+            }
+            return {};
+        }
+
+
+        /*
+         * Parse a reply to our query. `final` is set when retrying is pointless, even if
+         * the reply is an error.
+         */
+        resolver::outcome
+        parse(const std::uint8_t* data,
+              std::size_t size,
+              bool& final)
+        {
+            final = false;
+            if (size < 12)
+                return std::unexpected{"DNS reply is too short."s};
+
+            std::uint16_t flags = get16(data + 2);
+            if (!(flags & 0x8000))
+                return std::unexpected{"DNS reply is not a response."s};
+            if (flags & 0x0200)
+                return std::unexpected{"DNS reply was truncated."s};
+            std::uint8_t rcode = flags & 0x000f;
+            if (rcode == rcode_nxdomain) {
+                final = true;
+                return std::unexpected{"DNS name not found."s};
+            }
+            if (rcode)
+                return std::unexpected{"DNS server error: "s + std::to_string(rcode)};
+
+            std::uint16_t qdcount = get16(data + 4);
+            std::uint16_t ancount = get16(data + 6);
+
+            std::size_t pos = 12;
+            for (unsigned i = 0; i < qdcount; ++i) {
+                auto next = skip_name(data, size, pos);
+                if (!next || *next + 4 > size)
+                    return std::unexpected{"Malformed DNS reply."s};
+                pos = *next + 4;
+            }
+
+            resolver::answer result;
+            std::optional<std::uint32_t> min_ttl;
+            for (unsigned i = 0; i < ancount; ++i) {
+                auto next = skip_name(data, size, pos);
+                if (!next || *next + 10 > size)
+                    return std::unexpected{"Malformed DNS reply."s};
+                pos = *next;
+                std::uint16_t type = get16(data + pos);
+                std::uint16_t klass = get16(data + pos + 2);
+                std::uint32_t ttl = get32(data + pos + 4);
+                std::uint16_t rdlength = get16(data + pos + 8);
+                pos += 10;
+                if (pos + rdlength > size)
+                    return std::unexpected{"Malformed DNS reply."s};
+                // Note: CNAME records are skipped; the server already followed them.
+                if (type == type_a && klass == class_in && rdlength == 4) {
+                    result.addresses.push_back(get32(data + pos));
+                    min_ttl = std::min(min_ttl.value_or(ttl), ttl);
+                }
+                pos += rdlength;
+            }
+
+            final = true;
+            if (result.addresses.empty())
+                return std::unexpected{"DNS reply has no addresses."s};
+            result.ttl = std::chrono::seconds{*min_ttl};
+            return result;
+        }
+
+    } // namespace
+
+
+    resolver::resolver(std::vector<address> servers) :
+        servers{std::move(servers)},
+        sock{socket::type::udp}
+    {}
+
+
+    void
+    resolver::set_max_in_flight(std::size_t n)
+        noexcept
+    {
+        max_in_flight = n;
+    }
+
+
+    void
+    resolver::set_callback(std::function<void (std::size_t, const outcome&)> callback)
+    {
+        on_result = std::move(callback);
+    }
+
+
+    std::size_t
+    resolver::add(const std::string& name)
+    {
+        query q;
+        q.name = name;
+        // Note: IDs are unique within the resolver, so replies can't be mixed up.
+        do
+            q.id = random_id();
+        while (std::ranges::any_of(queries, [&q](const query& o) { return o.id == q.id; }));
+        q.result = std::unexpected{"Timeout reached!"s};
+        queries.push_back(std::move(q));
+        return queries.size() - 1;
+    }
+
+
+    coro::task<std::vector<resolver::outcome>>
+    resolver::run(reactor& r,
+                  std::chrono::milliseconds timeout,
+                  std::chrono::milliseconds retransmit)
+    {
+        if (servers.empty())
+            for (auto& q : queries)
+                if (!q.done)
+                    complete(q, std::unexpected{"No DNS servers."s});
+
+        const auto deadline = clock::now() + timeout;
+
+        for (;;) {
+            auto now = clock::now();
+            if (now >= deadline)
+                break;
+
+            std::size_t in_flight = std::ranges::count_if(queries,
+                                                          [](const query& q)
+                                                          {
+                                                              return q.attempts && !q.done;
+                                                          });
+            auto wake = deadline;
+            bool pending = false;
+            for (auto& q : queries) {
+                if (q.done)
+                    continue;
+                pending = true;
+                if (!q.attempts && max_in_flight && in_flight >= max_in_flight)
+                    continue; // no room yet, wait for another query to finish
+                if (q.next_send <= now) {
+                    bool first = !q.attempts;
+                    send(q, retransmit);
+                    if (first && q.attempts)
+                        ++in_flight;
+                }
+                if (!q.done)
+                    wake = std::min(wake, q.next_send);
+            }
+            if (!pending)
+                break;
+
+            auto events = co_await r.wait(sock, socket::poll_flags::in, wake);
+            if ((events & socket::poll_flags::in) != socket::poll_flags::none)
+                drain();
+        }
+
+        for (auto& q : queries)
+            if (!q.done)
+                complete(q, std::move(q.result));
+
+        std::vector<outcome> results;
+        results.reserve(queries.size());
+        for (auto& q : queries)
+            results.push_back(std::move(q.result));
+        co_return results;
+    }
+
+
+    void
+    resolver::send(query& q,
+                   std::chrono::milliseconds retransmit)
+    {
+        auto msg = make_query(q.name, q.id);
+        if (!msg) {
+            complete(q, std::unexpected{"Invalid name: "s + q.name});
+            return;
+        }
+
+        auto& server = servers[q.attempts % servers.size()];
+        auto status = sock.try_sendto(msg->data(), msg->size(), server,
+                                      socket::msg_flags::dontwait);
+        if (!status) {
+            auto& e = status.error();
+            if (e.code() != std::errc::not_enough_memory
+                && e.code() != std::errc::operation_would_block
+                && e.code() != std::errc::resource_unavailable_try_again) {
+                complete(q, std::unexpected{std::string{e.what()}});
+                return;
+            }
+            // No buffers right now, try again soon.
+            q.next_send = clock::now() + 100ms;
+            return;
+        }
+
+        ++q.attempts;
+        q.next_send = clock::now() + retransmit;
+    }
+
+
+    // Read every datagram already queued in the socket, without blocking.
+    void
+    resolver::drain()
+    {
+        for (;;) {
+            std::array<std::uint8_t, max_message> buf;
+            auto status = sock.try_recvfrom(buf.data(), buf.size(), socket::msg_flags::dontwait);
+            if (!status) {
+                auto& e = status.error();
+                // Note: other errors only affect this read; the queries are retransmitted.
+                if (e.code() != std::errc::operation_would_block
+                    && e.code() != std::errc::resource_unavailable_try_again)
+                    logger::printf("Error reading DNS replies: %s\n", e.what());
+                return;
+            }
+
+            auto [size, source] = *status;
+            if (size < 2 || std::ranges::find(servers, source) == servers.end())
+                continue;
+
+            std::uint16_t id = get16(buf.data());
+            auto it = std::ranges::find_if(queries,
+                                           [id](const query& q)
+                                           {
+                                               return !q.done && q.id == id;
+                                           });
+            if (it == queries.end())
+                continue;
+
+            // A reply to a different question is not for us, even if the ID matches.
+            auto msg = make_query(it->name, id);
+            if (!msg || !same_question(buf.data(), size, *msg))
+                continue;
+
+            bool final;
+            auto result = parse(buf.data(), size, final);
+            // Note: a failure that is not final is retried, but kept in case time runs out.
+            if (final || result)
+                complete(*it, std::move(result));
+            else
+                it->result = std::move(result);
+        }
+    }
+
+
+    void
+    resolver::complete(query& q,
+                       outcome result)
+    {
+        q.result = std::move(result);
+        q.done = true;
+        if (on_result)
+            on_result(&q - queries.data(), q.result);
+    }
+
+} // namespace net
@@ -6,18 +6,25 @@
  * SPDX-License-Identifier: MIT
  */
 
+#include <algorithm>            // min()
 #include <cerrno>
 #include <cstddef>              // byte
+#include <cstring>              // memcpy()
 #include <stdexcept>
 #include <thread>
+#include <time.h>               // clock_gettime()
 
 #include <arpa/inet.h>          // ntohl()
 #include <sys/socket.h>         // socket()
 #include <unistd.h>             // close()
 #include <whb/log.h>
 
+#include <coreinit/time.h>      // OSGetSystemTime()
+
 #include "net/socket.hpp"
 
+#include "net/poll_gate.hpp"
+
 
 // Note: WUT doesn't have SOL_IP, but IPPROTO_IP seems to work.
 #ifndef SOL_IP
@@ -27,6 +34,42 @@
 
 namespace net {
 
+    namespace {
+
+        std::int64_t
+        now_ticks()
+            noexcept
+        {
+            return OSGetSystemTime();
+        }
+
+
+#ifdef __linux__
+
+        /*
+         * The kernel stamps received datagrams with CLOCK_REALTIME; map it to system
+         * ticks through how long ago it was.
+         */
+        std::int64_t
+        realtime_to_ticks(const timespec& ts)
+            noexcept
+        {
+            auto ticks = now_ticks();
+            timespec real_now;
+            clock_gettime(CLOCK_REALTIME, &real_now);
+            std::int64_t ns_ago = (real_now.tv_sec - ts.tv_sec) * 1'000'000'000LL
+                                + (real_now.tv_nsec - ts.tv_nsec);
+            if (ns_ago < 0)
+                ns_ago = 0;
+            return ticks - ns_ago * static_cast<std::int64_t>(OSTimerClockSpeed)
+                / 1'000'000'000;
+        }
+
+#endif
+
+    } // namespace
+
+
     // bitwise operations for socket::msg_flags
 
     socket::msg_flags
@@ -92,6 +135,14 @@ namespace net {
 
         if (fd == -1)
             throw error{errno};
+
+#ifdef __linux__
+        // Let recvmmsg() report when each datagram arrived.
+        if (t == type::udp) {
+            int on = 1;
+            ::setsockopt(fd, SOL_SOCKET, SO_TIMESTAMPNS, &on, sizeof on);
+        }
+#endif
     }
 
 
@@ -611,6 +662,17 @@ namespace net {
     }
 
 
+    std::size_t
+    socket::recvmmsg(std::span<incoming> msgs,
+                     msg_flags flags)
+    {
+        auto status = try_recvmmsg(msgs, flags);
+        if (!status)
+            throw status.error();
+        return *status;
+    }
+
+
     int
     socket::release()
         noexcept
@@ -621,6 +683,14 @@ namespace net {
     }
 
 
+    int
+    socket::native_handle()
+        const noexcept
+    {
+        return fd;
+    }
+
+
     std::size_t
     socket::send(const void* buf, std::size_t len,
                  msg_flags flags)
@@ -658,6 +728,17 @@ namespace net {
     }
 
 
+    std::size_t
+    socket::sendmmsg(std::span<outgoing> msgs,
+                     msg_flags flags)
+    {
+        auto status = try_sendmmsg(msgs, flags);
+        if (!status)
+            throw status.error();
+        return *status;
+    }
+
+
     std::size_t
     socket::sendto(const void* buf, std::size_t len,
                    address dst,
@@ -844,7 +925,7 @@ namespace net {
         const noexcept
     {
         pollfd pf{ fd, static_cast<int>(flags), 0 };
-        int status = ::poll(&pf, 1, timeout.count());
+        int status = poll_gate::poll(&pf, 1, timeout);
         if (status == -1)
             return std::unexpected{error{errno}};
         return poll_flags{pf.revents};
@@ -904,6 +985,154 @@ namespace net {
     }
 
 
+#ifdef __linux__
+
+    std::expected<std::size_t, error>
+    socket::try_recvmmsg(std::span<incoming> msgs,
+                         msg_flags flags)
+        noexcept
+    {
+        constexpr std::size_t max_batch = 16;
+        std::size_t done = 0;
+        while (done < msgs.size()) {
+            auto batch = msgs.subspan(done, std::min(max_batch, msgs.size() - done));
+            mmsghdr headers[max_batch] = {};
+            iovec vecs[max_batch];
+            sockaddr_in srcs[max_batch];
+            alignas(cmsghdr) char controls[max_batch][CMSG_SPACE(sizeof(timespec))];
+            for (std::size_t i = 0; i < batch.size(); ++i) {
+                vecs[i] = { batch[i].buf, batch[i].len };
+                headers[i].msg_hdr.msg_name = &srcs[i];
+                headers[i].msg_hdr.msg_namelen = sizeof srcs[i];
+                headers[i].msg_hdr.msg_iov = &vecs[i];
+                headers[i].msg_hdr.msg_iovlen = 1;
+                headers[i].msg_hdr.msg_control = controls[i];
+                headers[i].msg_hdr.msg_controllen = sizeof controls[i];
+            }
+            int status = ::recvmmsg(fd, headers, batch.size(), static_cast<int>(flags), nullptr);
+            if (status == -1) {
+                if (!done)
+                    return std::unexpected{error{errno}};
+                batch[0].error = errno;
+                break;
+            }
+            auto ticks = now_ticks();
+            for (int i = 0; i < status; ++i) {
+                batch[i].src = address{srcs[i]};
+                batch[i].size = headers[i].msg_len;
+                batch[i].error = 0;
+                batch[i].ticks = ticks;
+                // Each datagram has its own arrival time, if the kernel reported it.
+                auto& hdr = headers[i].msg_hdr;
+                for (auto c = CMSG_FIRSTHDR(&hdr); c; c = CMSG_NXTHDR(&hdr, c))
+                    if (c->cmsg_level == SOL_SOCKET && c->cmsg_type == SCM_TIMESTAMPNS) {
+                        timespec ts;
+                        std::memcpy(&ts, CMSG_DATA(c), sizeof ts);
+                        batch[i].ticks = realtime_to_ticks(ts);
+                    }
+            }
+            done += status;
+            if (static_cast<std::size_t>(status) < batch.size())
+                break;
+        }
+        return done;
+    }
+
+
+    std::expected<std::size_t, error>
+    socket::try_sendmmsg(std::span<outgoing> msgs,
+                         msg_flags flags)
+        noexcept
+    {
+        constexpr std::size_t max_batch = 16;
+        std::size_t done = 0;
+        while (done < msgs.size()) {
+            auto batch = msgs.subspan(done, std::min(max_batch, msgs.size() - done));
+            mmsghdr headers[max_batch] = {};
+            iovec vecs[max_batch];
+            sockaddr_in dsts[max_batch];
+            for (std::size_t i = 0; i < batch.size(); ++i) {
+                vecs[i] = { const_cast<void*>(batch[i].buf), batch[i].len };
+                dsts[i] = batch[i].dst.data();
+                headers[i].msg_hdr.msg_name = &dsts[i];
+                headers[i].msg_hdr.msg_namelen = sizeof dsts[i];
+                headers[i].msg_hdr.msg_iov = &vecs[i];
+                headers[i].msg_hdr.msg_iovlen = 1;
+            }
+            // Note: there's no per-datagram send time, the whole batch shares this one.
+            auto ticks = now_ticks();
+            int status = ::sendmmsg(fd, headers, batch.size(), static_cast<int>(flags));
+            if (status == -1) {
+                if (!done)
+                    return std::unexpected{error{errno}};
+                batch[0].error = errno;
+                break;
+            }
+            for (int i = 0; i < status; ++i) {
+                batch[i].size = headers[i].msg_len;
+                batch[i].error = 0;
+                batch[i].ticks = ticks;
+            }
+            done += status;
+            if (static_cast<std::size_t>(status) < batch.size())
+                break;
+        }
+        return done;
+    }
+
+#else
+
+    // Note: the Wii U has no sendmmsg()/recvmmsg(), so these are plain loops.
+
+    std::expected<std::size_t, error>
+    socket::try_recvmmsg(std::span<incoming> msgs,
+                         msg_flags flags)
+        noexcept
+    {
+        std::size_t done = 0;
+        for (auto& msg : msgs) {
+            auto status = try_recvfrom(msg.buf, msg.len, flags);
+            if (!status) {
+                if (!done)
+                    return std::unexpected{status.error()};
+                msg.error = status.error().code().value();
+                break;
+            }
+            msg.ticks = now_ticks();
+            msg.size = status->first;
+            msg.src = status->second;
+            msg.error = 0;
+            ++done;
+        }
+        return done;
+    }
+
+
+    std::expected<std::size_t, error>
+    socket::try_sendmmsg(std::span<outgoing> msgs,
+                         msg_flags flags)
+        noexcept
+    {
+        std::size_t done = 0;
+        for (auto& msg : msgs) {
+            msg.ticks = now_ticks();
+            auto status = try_sendto(msg.buf, msg.len, msg.dst, flags);
+            if (!status) {
+                if (!done)
+                    return std::unexpected{status.error()};
+                msg.error = status.error().code().value();
+                break;
+            }
+            msg.size = *status;
+            msg.error = 0;
+            ++done;
+        }
+        return done;
+    }
+
+#endif
+
+
     std::expected<std::size_t, error>
     socket::try_send(const void* buf, std::size_t len,
                      msg_flags flags)
@@ -6,10 +6,14 @@
  * SPDX-License-Identifier: MIT
  */
 
-#include <bit>                  // endian, byteswap()
-#include <cmath>                // ldexp()
+#include <algorithm>            // max(), min(), min_element(), sort()
+#include <cmath>                // ldexp(), sqrt()
+#include <optional>
+#include <ranges>               // views::reverse
+#include <stdexcept>            // logic_error, runtime_error
+#include <utility>              // pair<>
 
-#include <sys/endian.h>         // be64toh(), htobe64()
+#include <sys/endian.h>         // be32toh()
 
 #include "ntp.hpp"
 
@@ -34,27 +38,18 @@ namespace ntp {
     }
 
 
-    std::uint64_t
-    timestamp::load()
+    duration::operator dbl_seconds()
         const noexcept
     {
-        return be64toh(stored);
+        return dbl_seconds{std::ldexp(static_cast<double>(raw), -32)};
     }
 
 
-    void
-    timestamp::store(std::uint64_t v)
+    dbl_seconds
+    to_dbl_seconds(short_timestamp t)
         noexcept
     {
-        stored = htobe64(v);
-    }
-
-
-    std::strong_ordering
-    timestamp::operator <=>(timestamp other)
-        const noexcept
-    {
-        return load() <=> other.load();
+        return dbl_seconds{std::ldexp(static_cast<double>(be32toh(t)), -16)};
     }
 
 
@@ -131,4 +126,326 @@ namespace ntp {
         return static_cast<mode_flag>(lvm & 0b000'0111);
     }
 
+
+
+    void
+    clock_filter::add(const sample& s)
+    {
+        if (samples.size() == max_size)
+            samples.erase(samples.begin());
+        samples.push_back(s);
+    }
+
+
+    bool
+    clock_filter::empty()
+        const noexcept
+    {
+        return samples.empty();
+    }
+
+
+    std::size_t
+    clock_filter::size()
+        const noexcept
+    {
+        return samples.size();
+    }
+
+
+    const sample&
+    clock_filter::best()
+        const
+    {
+        if (samples.empty())
+            throw std::logic_error{"clock_filter is empty"};
+        return *std::ranges::min_element(samples, {}, &sample::delay);
+    }
+
+
+    dbl_seconds
+    clock_filter::offset()
+        const
+    {
+        return best().offset;
+    }
+
+
+    dbl_seconds
+    clock_filter::delay()
+        const
+    {
+        return best().delay;
+    }
+
+
+    dbl_seconds
+    clock_filter::dispersion()
+        const
+    {
+        if (samples.empty())
+            throw std::logic_error{"clock_filter is empty"};
+
+        // Age all samples to the time of the newest one.
+        const dbl_seconds now = samples.back().time;
+        std::vector<sample> sorted = samples;
+        for (auto& s : sorted)
+            s.dispersion += phi * (now - s.time);
+        std::ranges::sort(sorted, {}, &sample::delay);
+
+        // Weighted sum, each sample counts half as much as the previous one.
+        dbl_seconds result{0};
+        double weight = 0.5;
+        for (const auto& s : sorted) {
+            result += weight * s.dispersion;
+            weight /= 2;
+        }
+        return result;
+    }
+
+
+    dbl_seconds
+    clock_filter::jitter()
+        const
+    {
+        if (samples.size() < 2)
+            return dbl_seconds{0};
+
+        const sample& b = best();
+        double sum = 0;
+        for (const auto& s : samples) {
+            double d = (s.offset - b.offset).count();
+            sum += d * d;
+        }
+        return dbl_seconds{std::sqrt(sum / (samples.size() - 1))};
+    }
+
+
+
+    dbl_seconds
+    clock_filter::root_distance()
+        const
+    {
+        constexpr dbl_seconds min_dispersion{0.01};
+        const sample& b = best();
+        return std::max(min_dispersion, b.root_delay + b.delay) / 2.0
+            + b.root_dispersion + dispersion() + jitter();
+    }
+
+
+    namespace {
+
+        struct candidate {
+            std::size_t idx;
+            dbl_seconds offset;
+            dbl_seconds distance;
+            dbl_seconds jitter;
+            unsigned    stratum;
+        };
+
+
+        /*
+         * Marzullo's algorithm, as modified by the RFC. Returns the intersection interval,
+         * or nothing if no majority of the candidates agree.
+         */
+        std::optional<std::pair<dbl_seconds, dbl_seconds>>
+        intersect(const std::vector<candidate>& cands)
+        {
+            // Each candidate contributes its interval's endpoints (type -1 and +1), and its
+            // midpoint (type 0).
+            std::vector<std::pair<dbl_seconds, int>> edges;
+            for (const auto& c : cands) {
+                edges.emplace_back(c.offset - c.distance, -1);
+                edges.emplace_back(c.offset, 0);
+                edges.emplace_back(c.offset + c.distance, +1);
+            }
+            std::ranges::sort(edges);
+
+            const int n = cands.size();
+            // Allow f falsetickers, until a majority of the candidates agree.
+            for (int f = 0; 2 * f < n; ++f) {
+                int found = 0;
+                int chime = 0;
+
+                dbl_seconds low{0};
+                for (const auto& [edge, type] : edges) {
+                    chime -= type;
+                    if (chime >= n - f) {
+                        low = edge;
+                        break;
+                    }
+                    if (type == 0)
+                        ++found;
+                }
+
+                chime = 0;
+                dbl_seconds high{0};
+                for (const auto& [edge, type] : edges | std::views::reverse) {
+                    chime += type;
+                    if (chime >= n - f) {
+                        high = edge;
+                        break;
+                    }
+                    if (type == 0)
+                        ++found;
+                }
+
+                // If there are more midpoints outside the interval than falsetickers
+                // allowed, some of them would need to be falsetickers too.
+                if (found > f)
+                    continue;
+
+                if (low < high)
+                    return std::pair{low, high};
+            }
+
+            return {};
+        }
+
+
+        // Only consider servers that are synchronized and not too far from the root.
+        std::vector<candidate>
+        suitable(const std::vector<clock_filter>& filters)
+        {
+            std::vector<candidate> cands;
+            for (std::size_t i = 0; i < filters.size(); ++i) {
+                const auto& f = filters[i];
+                if (f.empty())
+                    continue;
+                auto stratum = f.best().stratum;
+                if (stratum == 0 || stratum >= 16)
+                    continue;
+                auto distance = f.root_distance();
+                if (distance > max_distance)
+                    continue;
+                cands.push_back({i, f.offset(), distance, f.jitter(), stratum});
+            }
+            return cands;
+        }
+
+
+        // RMS of the offset differences between c and all others.
+        dbl_seconds
+        selection_jitter(const candidate& c,
+                         const std::vector<candidate>& cands)
+        {
+            double sum = 0;
+            for (const auto& other : cands) {
+                double d = (other.offset - c.offset).count();
+                sum += d * d;
+            }
+            return dbl_seconds{std::sqrt(sum / (cands.size() - 1))};
+        }
+
+    } // namespace
+
+
+    std::size_t
+    agreement(const std::vector<clock_filter>& filters)
+    {
+        // Sweep over the interval endpoints; at equal positions, openings come first.
+        std::vector<std::pair<dbl_seconds, int>> edges;
+        for (const auto& c : suitable(filters)) {
+            edges.emplace_back(c.offset - c.distance, -1);
+            edges.emplace_back(c.offset + c.distance, +1);
+        }
+        std::ranges::sort(edges);
+
+        std::size_t overlap = 0;
+        std::size_t result = 0;
+        for (const auto& [edge, type] : edges) {
+            if (type < 0)
+                result = std::max(result, ++overlap);
+            else
+                --overlap;
+        }
+        return result;
+    }
+
+
+    bool
+    has_majority(const std::vector<clock_filter>& filters)
+    {
+        auto cands = suitable(filters);
+        return !cands.empty() && intersect(cands);
+    }
+
+
+    selection
+    select(const std::vector<clock_filter>& filters)
+    {
+        auto cands = suitable(filters);
+        if (cands.empty())
+            throw std::runtime_error{"No NTP server is suitable for synchronization."};
+
+        auto interval = intersect(cands);
+        if (!interval)
+            throw std::runtime_error{"No majority of NTP servers agree on the time."};
+        auto [low, high] = *interval;
+
+        selection result;
+
+        // The truechimers are all candidates whose intervals overlap the intersection.
+        std::erase_if(cands,
+                      [low, high](const candidate& c)
+                      {
+                          return c.offset + c.distance < low || c.offset - c.distance > high;
+                      });
+        for (const auto& c : cands)
+            result.truechimers.push_back(c.idx);
+
+        // Sort them by merit: lower stratum first, then lower root distance.
+        std::ranges::sort(cands,
+                          [](const candidate& a, const candidate& b)
+                          {
+                              auto merit = [](const candidate& c)
+                              {
+                                  return c.stratum * max_distance + c.distance;
+                              };
+                              return merit(a) < merit(b);
+                          });
+
+        // Cluster: discard the outliers, while it reduces the overall jitter.
+        while (cands.size() > min_cluster) {
+            auto worst = cands.begin();
+            dbl_seconds max_sel_jitter{0};
+            for (auto it = cands.begin(); it != cands.end(); ++it) {
+                auto sj = selection_jitter(*it, cands);
+                if (sj > max_sel_jitter) {
+                    max_sel_jitter = sj;
+                    worst = it;
+                }
+            }
+            auto min_peer_jitter = std::ranges::min(cands, {}, &candidate::jitter).jitter;
+            if (max_sel_jitter <= min_peer_jitter)
+                break;
+            cands.erase(worst);
+        }
+        for (const auto& c : cands)
+            result.survivors.push_back(c.idx);
+
+        // Combine: weighted average, using the inverse of the root distance as weight.
+        double total_weight = 0;
+        dbl_seconds offset{0};
+        for (const auto& c : cands) {
+            double w = 1.0 / c.distance.count();
+            total_weight += w;
+            offset += w * c.offset;
+        }
+        result.offset = offset / total_weight;
+
+        // System jitter, relative to the best survivor.
+        double sum = 0;
+        for (const auto& c : cands) {
+            double d = (c.offset - cands.front().offset).count();
+            sum += d * d / c.distance.count();
+        }
+        result.jitter = dbl_seconds{std::sqrt(sum / total_weight)};
+
+        // The true offset is somewhere inside the intersection interval.
+        result.error = std::max(high - result.offset, result.offset - low);
+
+        return result;
+    }
+
 } // namespace ntp
@@ -0,0 +1,652 @@
+/*
+ * Wii U Time Sync - A NTP client plugin for the Wii U.
+ *
+ * Copyright (C) 2025  Daniel K. O.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <algorithm>            // max(), min(), ranges::count_if()
+#include <array>
+#include <cmath>                // ldexp()
+#include <stdexcept>            // runtime_error
+#include <string>
+#include <utility>              // move()
+
+#include <coreinit/time.h>
+
+#include <wupsxx/logger.hpp>
+
+#include "ntp_session.hpp"
+
+#include "utc.hpp"
+
+
+using namespace std::literals;
+using std::runtime_error;
+
+namespace logger = wups::logger;
+
+using time_utils::dbl_seconds;
+
+
+namespace {
+
+    // Difference from NTP (1900) to Wii U (2000) epochs, in seconds.
+    // There are 24 leap years in this period.
+    constexpr std::uint64_t seconds_per_day = 24 * 60 * 60;
+    constexpr std::uint64_t epoch_diff = seconds_per_day * (100 * 365 + 24);
+
+
+    // Wii U ticks since 2000 -> NTP timestamp, without going through floating-point.
+    ntp::timestamp
+    to_ntp(std::uint64_t ticks)
+        noexcept
+    {
+        const std::uint64_t speed = OSTimerClockSpeed;
+        std::uint64_t secs = ticks / speed + epoch_diff;
+        // Note: the remainder is smaller than 2^26, so shifting it by 32 cannot overflow.
+        std::uint64_t frac = ((ticks % speed) << 32) / speed;
+        ntp::timestamp result;
+        result.store((secs << 32) | frac);
+        return result;
+    }
+
+
+    // Our clock is read as system ticks, with about 16 ns of resolution.
+    constexpr dbl_seconds local_precision{0x1.0p-25};
+
+
+    // Note: RFC 6298 uses 1 s as the minimum RTO, but that's too slow for UDP.
+    constexpr std::chrono::milliseconds min_rto = 250ms;
+
+    // The RTO for servers we know nothing about, as in RFC 6298.
+    constexpr std::chrono::milliseconds initial_rto = 1s;
+
+    // How many copies of a request are sent, besides the original.
+    constexpr unsigned max_retransmits = 4;
+
+
+    // The kiss code is four ASCII characters, like "RATE" or "DENY".
+    std::string
+    kiss_code(const char (&id)[4])
+    {
+        std::string code;
+        for (char c : id)
+            if (c >= ' ' && c <= '~')
+                code += c;
+        return code;
+    }
+
+
+    /*
+     * Validate the server's reply, and calculate the sample.
+     * Throws std::runtime_error if the reply cannot be used.
+     */
+    ntp::sample
+    process(const ntp::packet& packet,
+            OSTime t1_ticks,
+            OSTime t4_ticks)
+    {
+        using std::to_string;
+
+        auto v = packet.version();
+        if (v < 3 || v > 4)
+            throw runtime_error{"Unsupported NTP version: "s + to_string(v)};
+
+        auto m = packet.mode();
+        if (m != ntp::packet::mode_flag::server)
+            throw runtime_error{"Invalid NTP packet mode: "s + to_string(m)};
+
+        auto l = packet.leap();
+        if (l == ntp::packet::leap_flag::unknown)
+            throw runtime_error{"Unknown value for leap flag."};
+
+        // Kiss-o'-death (RFC 5905, section 7.4): the server refuses to answer.
+        if (packet.stratum == 0)
+            throw runtime_error{"NTP server sent kiss-o'-death: "s
+                                + kiss_code(packet.reference_id)};
+        if (packet.stratum > 15)
+            throw runtime_error{"NTP server is not synchronized."};
+
+        /*
+         * Map the monotonic ticks to UTC only now, once per sample. The round-trip is not
+         * affected if the clock was set by another thread during the query.
+         */
+        auto mapping = utc::system_ticks_offset();
+        auto t1 = to_ntp(t1_ticks + mapping);
+        auto t4 = to_ntp(t4_ticks + mapping);
+
+        // when our request arrived at the server
+        auto t2 = packet.receive_time;
+        // when the server sent out a response
+        auto t3 = packet.transmit_time;
+
+        // Zero is not a valid timestamp.
+        if (!t2 || !t3)
+            throw runtime_error{"NTP response has invalid timestamps."};
+
+        /*
+         * All differences are done in fixed-point, and are era-aware, so the wraparound at
+         * the end of Era 0 (in 2036) needs no special handling. Only the final results are
+         * converted to floating-point, so we keep the full 32 fractional bits until then.
+         *
+         * Note: each difference is about as large as the offset itself, so they're halved
+         * before adding, as in RFC 5905; the sum alone would overflow past 34 years.
+         */
+        ntp::duration roundtrip = (t4 - t1) - (t3 - t2);
+        ntp::duration offset = (t2 - t1).half() + (t3 - t4).half();
+
+        dbl_seconds server_precision{std::ldexp(1.0, packet.precision_exp)};
+
+        ntp::sample result;
+        result.offset          = static_cast<dbl_seconds>(offset);
+        result.delay           = static_cast<dbl_seconds>(roundtrip);
+        result.dispersion      = local_precision + server_precision
+                               + ntp::phi * static_cast<dbl_seconds>(t4 - t1);
+        result.time            = dbl_seconds{static_cast<double>(t4_ticks) / OSTimerClockSpeed};
+        result.stratum         = packet.stratum;
+        result.root_delay      = ntp::to_dbl_seconds(packet.root_delay);
+        result.root_dispersion = ntp::to_dbl_seconds(packet.root_dispersion);
+        return result;
+    }
+
+} // namespace
+
+
+ntp_session::ntp_session(std::chrono::milliseconds interval) :
+    interval{interval},
+    sock{net::socket::type::udp}
+{}
+
+
+void
+ntp_session::add(net::address address,
+                 unsigned count,
+                 std::optional<std::chrono::milliseconds> rtt)
+{
+    server s;
+    s.address = address;
+    s.to_send = count;
+    s.rto = initial_rto;
+    if (rtt && rtt->count() > 0) {
+        s.srtt = *rtt;
+        s.rttvar = *rtt / 2;
+        s.rto = std::max<clock::duration>(s.srtt + 4 * s.rttvar, min_rto);
+    }
+    servers.push_back(std::move(s));
+    wake_up();
+}
+
+
+void
+ntp_session::open()
+    noexcept
+{
+    accepting = true;
+}
+
+
+void
+ntp_session::close()
+    noexcept
+{
+    accepting = false;
+    wake_up();
+}
+
+
+void
+ntp_session::set_max_active(std::size_t n)
+    noexcept
+{
+    max_active = n;
+}
+
+
+void
+ntp_session::set_stagger(std::chrono::milliseconds delay)
+    noexcept
+{
+    stagger = delay;
+}
+
+
+void
+ntp_session::wake_up()
+    noexcept
+{
+    if (waiting_op)
+        waiting_reactor->wake(*waiting_op);
+}
+
+
+struct ntp_session::waiting_guard {
+
+    ntp_session& session;
+
+    waiting_guard(ntp_session& session,
+                  net::reactor& reactor,
+                  net::reactor::wait_op& op)
+        noexcept :
+        session(session)
+    {
+        session.waiting_reactor = &reactor;
+        session.waiting_op = &op;
+    }
+
+    ~waiting_guard()
+    {
+        session.waiting_op = nullptr;
+    }
+
+};
+
+
+coro::task<std::vector<ntp_session::response>>
+ntp_session::run(net::reactor& reactor,
+                 std::chrono::milliseconds timeout,
+                 std::size_t quorum)
+{
+    std::vector<response> results;
+    results.reserve(servers.size());
+
+    for (;;) {
+        auto now = clock::now();
+
+        std::size_t active = std::ranges::count_if(servers,
+                                                   [](const server& s)
+                                                   {
+                                                       return s.started && !s.finished;
+                                                   });
+        auto can_send = [this, &active](const server& s) -> bool
+        {
+            return s.to_send && (s.started || !max_active || active < max_active);
+        };
+        // Note: unstarted servers also wait for their launch slot, if staggered.
+        auto launch = launch_time(now, results, quorum);
+        auto send_time = [this, launch](const server& s) -> clock::time_point
+        {
+            if (s.started || !stagger.count())
+                return s.next_send;
+            return std::max({ s.next_send, launch, next_launch });
+        };
+
+        // Send everything that is due in one batch; only the failures are retried.
+        std::vector<request> due;
+        for (std::size_t i = 0; i < servers.size(); ++i) {
+            auto& s = servers[i];
+            if (can_send(s) && send_time(s) <= now) {
+                if (!s.started) {
+                    s.started = true;
+                    ++active;
+                    s.launched = now;
+                    next_launch = now + stagger;
+                }
+                due.push_back({ .server_idx = i,
+                                .slot = s.next_slot++,
+                                .expiration = now + timeout });
+                --s.to_send;
+                s.next_send = now + interval;
+            }
+        }
+        // Requests not answered within the RTO are sent again; the original stays valid.
+        for (auto& [key, req] : requests) {
+            if (req.retransmit > now)
+                continue;
+            request copy = req;
+            ++copy.attempt;
+            copy.retransmit = clock::time_point::max();
+            due.push_back(copy);
+            req.retransmit = clock::time_point::max();
+        }
+        std::vector<request> retry;
+        try {
+            retry = send_batch(due);
+        }
+        catch (std::exception&) {
+            retry = std::move(due);
+        }
+        for (const auto& req : retry) {
+            try {
+                co_await send(reactor, req);
+            }
+            catch (std::exception& e) {
+                // Note: a failed retransmission is not fatal, the original is still valid.
+                if (req.attempt)
+                    continue;
+                servers[req.server_idx].error = e.what();
+                servers[req.server_idx].to_send = 0;
+            }
+        }
+
+        expire(clock::now());
+        if (finish(results) && quorum && quorum_reached(results, quorum))
+            break;
+
+        // Find out when we need to wake up again.
+        auto wake = clock::time_point::max();
+        for (const auto& s : servers)
+            if (can_send(s))
+                wake = std::min(wake, send_time(s));
+        for (const auto& [key, req] : requests)
+            wake = std::min({ wake, req.expiration, req.retransmit });
+        if (wake == clock::time_point::max() && !accepting)
+            break;
+
+        using net::socket;
+        auto op = reactor.wait(sock, socket::poll_flags::in, wake);
+        // Note: the guard also cleans up if the coroutine is destroyed while suspended.
+        waiting_guard guard{*this, reactor, op};
+        auto events = co_await op;
+        if ((events & socket::poll_flags::in) != socket::poll_flags::none)
+            drain();
+    }
+
+    sock.close(); // close it early
+
+    co_return results;
+}
+
+
+utc::clock_anchor
+ntp_session::anchor()
+    const noexcept
+{
+    return latest_anchor;
+}
+
+
+std::vector<ntp_session::request>
+ntp_session::send_batch(const std::vector<request>& batch)
+{
+    if (batch.empty())
+        return {};
+
+    std::vector<ntp::packet> packets(batch.size());
+    std::vector<net::socket::outgoing> msgs(batch.size());
+    // Note: keys only need to be unique, so the batch just counts up from one reading.
+    auto key = to_ntp(OSGetSystemTime());
+    for (std::size_t i = 0; i < batch.size(); ++i) {
+        auto& packet = packets[i];
+        packet.version(4);
+        packet.mode(ntp::packet::mode_flag::client);
+        key = unique_key(key);
+        packet.transmit_time = key;
+        key.store(key.load() + 1);
+        msgs[i].buf = &packet;
+        msgs[i].len = sizeof packet;
+        msgs[i].dst = servers[batch[i].server_idx].address;
+    }
+
+    auto status = sock.try_sendmmsg(msgs, net::socket::msg_flags::dontwait);
+    std::size_t count = status ? *status : 0;
+
+    for (std::size_t i = 0; i < count; ++i) {
+        auto req = batch[i];
+        // The send ticks are more precise than the key, so they are used as t1.
+        req.t1_ticks = msgs[i].ticks;
+        sent(packets[i].transmit_time, req);
+    }
+
+    return {batch.begin() + count, batch.end()};
+}
+
+
+coro::task<void>
+ntp_session::send(net::reactor& reactor,
+                  request req)
+{
+    ntp::packet packet;
+    packet.version(4);
+    packet.mode(ntp::packet::mode_flag::client);
+
+    auto& s = servers[req.server_idx];
+
+    const unsigned max_send_attempts = 4;
+    for (unsigned send_attempts = 1; ; ++send_attempts) {
+        /*
+         * The transmit timestamp only needs to be unique, since it is the key for the
+         * reply; the server just echoes it back. So we send the raw system ticks, and only
+         * map them to UTC once the reply arrives.
+         */
+        OSTime t1_ticks = OSGetSystemTime();
+        auto key = unique_key(to_ntp(t1_ticks));
+        packet.transmit_time = key;
+
+        auto send_status = sock.try_sendto(&packet, sizeof packet, s.address,
+                                           net::socket::msg_flags::dontwait);
+        if (send_status) {
+            req.t1_ticks = t1_ticks;
+            sent(key, req);
+            co_return;
+        }
+
+        auto& e = send_status.error();
+        if (e.code() != std::errc::not_enough_memory
+            && e.code() != std::errc::operation_would_block
+            && e.code() != std::errc::resource_unavailable_try_again)
+            throw e;
+        if (send_attempts == max_send_attempts)
+            throw runtime_error{"No resources for send(), too many retries!"};
+        co_await reactor.sleep_until(clock::now() + 100ms);
+    }
+}
+
+
+void
+ntp_session::sent(ntp::timestamp key,
+                  request req)
+{
+    auto& s = servers[req.server_idx];
+    if (req.attempt < max_retransmits) {
+        // Exponential backoff, like TCP; no point in going past the expiration.
+        auto when = clock::now() + s.rto * (1u << req.attempt);
+        if (when < req.expiration)
+            req.retransmit = when;
+    }
+    requests.emplace(key, req);
+    ++s.outstanding;
+}
+
+
+// Update the RTO estimator with a new round-trip time, as in RFC 6298.
+void
+ntp_session::update_rto(server& s,
+                        clock::duration rtt)
+    noexcept
+{
+    if (s.srtt == clock::duration::zero()) {
+        s.srtt = rtt;
+        s.rttvar = rtt / 2;
+    } else {
+        auto err = s.srtt > rtt ? s.srtt - rtt : rtt - s.srtt;
+        s.rttvar = (3 * s.rttvar + err) / 4;
+        s.srtt = (7 * s.srtt + rtt) / 8;
+    }
+    s.rto = std::max<clock::duration>(s.srtt + 4 * s.rttvar, min_rto);
+}
+
+
+ntp::timestamp
+ntp_session::unique_key(ntp::timestamp key)
+    const
+{
+    while (requests.contains(key))
+        key.store(key.load() + 1);
+    return key;
+}
+
+
+// Drop all requests that waited too long for a reply.
+void
+ntp_session::expire(clock::time_point now)
+{
+    std::erase_if(requests,
+                  [this, now](const auto& entry) -> bool
+                  {
+                      const request& req = entry.second;
+                      if (req.expiration > now)
+                          return false;
+                      auto& s = servers[req.server_idx];
+                      --s.outstanding;
+                      if (s.error.empty())
+                          s.error = "Timeout reached!";
+                      next_launch = {}; // start another server right away
+                      return true;
+                  });
+}
+
+
+// Report the servers that have nothing else to send or receive.
+bool
+ntp_session::finish(std::vector<response>& results)
+{
+    bool reported = false;
+    for (auto& s : servers) {
+        if (s.finished || s.to_send || s.outstanding)
+            continue;
+        s.finished = true;
+        reported = true;
+        if (!s.filter.empty())
+            results.emplace_back(s.address, s.filter);
+        else
+            results.emplace_back(s.address, std::unexpected{s.error});
+    }
+    return reported;
+}
+
+
+ntp_session::clock::time_point
+ntp_session::launch_time(clock::time_point now,
+                         const std::vector<response>& results,
+                         std::size_t quorum)
+    const
+{
+    if (!stagger.count() || !quorum)
+        return next_launch;
+
+    std::vector<ntp::clock_filter> filters;
+    for (const auto& r : results)
+        if (r.result)
+            filters.push_back(*r.result);
+    std::size_t agreed = filters.empty() ? 0 : ntp::agreement(filters);
+    if (agreed >= quorum) {
+        if (ntp::has_majority(filters))
+            return clock::time_point::max();
+        // The others disagree: more servers are needed to outvote them.
+        return next_launch;
+    }
+
+    // Count the running servers that can still help: replying, or not late yet.
+    std::size_t busy = 0;
+    auto late = clock::time_point::max();
+    for (const auto& s : servers) {
+        if (!s.started || s.finished)
+            continue;
+        if (!s.filter.empty()) {
+            ++busy;
+            continue;
+        }
+        auto deadline = s.launched + stagger;
+        if (deadline > now) {
+            ++busy;
+            late = std::min(late, deadline);
+        }
+    }
+    if (busy >= quorum - agreed)
+        return std::max(next_launch, late);
+    return next_launch;
+}
+
+
+bool
+ntp_session::quorum_reached(const std::vector<response>& results,
+                            std::size_t quorum)
+{
+    std::vector<ntp::clock_filter> filters;
+    for (const auto& r : results)
+        if (r.result)
+            filters.push_back(*r.result);
+    if (filters.size() < quorum)
+        return false;
+    // Note: the agreeing servers must also outvote the others, or select() would fail.
+    return ntp::agreement(filters) >= quorum && ntp::has_majority(filters);
+}
+
+
+// Read every datagram already queued in the socket, without blocking.
+void
+ntp_session::drain()
+{
+    constexpr std::size_t batch_size = 8;
+    std::array<ntp::packet, batch_size> packets;
+    std::array<net::socket::incoming, batch_size> msgs;
+
+    for (;;) {
+        for (std::size_t i = 0; i < batch_size; ++i) {
+            msgs[i].buf = &packets[i];
+            msgs[i].len = sizeof packets[i];
+        }
+
+        auto recv_status = sock.try_recvmmsg(msgs, net::socket::msg_flags::dontwait);
+        if (!recv_status) {
+            auto& e = recv_status.error();
+            // Note: other errors only affect this read; the requests can still be answered.
+            if (e.code() != std::errc::operation_would_block
+                && e.code() != std::errc::resource_unavailable_try_again)
+                logger::printf("Error reading NTP replies: %s\n", e.what());
+            return;
+        }
+
+        for (std::size_t i = 0; i < *recv_status; ++i) {
+            const auto& packet = packets[i];
+            // The arrival time was measured as soon as the datagram was read.
+            OSTime t4_ticks = msgs[i].ticks;
+
+            // Anything that doesn't match an outstanding request is silently dropped.
+            auto it = requests.find(packet.origin_time);
+            if (it == requests.end())
+                continue;
+            auto req = it->second;
+            auto& s = servers[req.server_idx];
+            if (s.address != msgs[i].src)
+                continue;
+            requests.erase(it);
+            --s.outstanding;
+            next_launch = {}; // start another server right away
+
+            // The other copies of this request are not needed anymore.
+            std::erase_if(requests,
+                          [&req, &s](const auto& entry) -> bool
+                          {
+                              const request& other = entry.second;
+                              if (other.server_idx != req.server_idx || other.slot != req.slot)
+                                  return false;
+                              --s.outstanding;
+                              return true;
+                          });
+
+            ntp::sample sample;
+            try {
+                if (msgs[i].size < 48)
+                    throw runtime_error{"Invalid NTP response!"};
+                sample = process(packet, req.t1_ticks, t4_ticks);
+            }
+            catch (std::exception& e) {
+                s.error = e.what();
+                // Note: after a kiss-o'-death, the rest of the burst is not sent.
+                if (msgs[i].size >= 48 && packet.stratum == 0)
+                    s.to_send = 0;
+                continue;
+            }
+
+            // Note: every copy has its own key, so the round-trip time is never ambiguous.
+            dbl_seconds rtt{static_cast<double>(t4_ticks - req.t1_ticks) / OSTimerClockSpeed};
+            update_rto(s, std::chrono::duration_cast<clock::duration>(rtt));
+
+            s.filter.add(sample);
+            latest_anchor = utc::make_anchor(t4_ticks);
+        }
+    }
+}
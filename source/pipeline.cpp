@@ -0,0 +1,194 @@
+/*
+ * Wii U Time Sync - A NTP client plugin for the Wii U.
+ *
+ * Copyright (C) 2025  Daniel K. O.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <algorithm>            // min()
+#include <atomic>
+#include <exception>
+#include <optional>
+#include <utility>              // move()
+
+#include <wupsxx/logger.hpp>
+
+#include "pipeline.hpp"
+
+#include "dns_cache.hpp"
+#include "net/notifier.hpp"
+#include "notify.hpp"
+#include "scoreboard.hpp"
+
+
+using namespace std::literals;
+
+namespace logger = wups::logger;
+
+
+namespace {
+
+    std::vector<net::address>
+    addresses_of(const std::vector<net::addrinfo::result>& infos)
+    {
+        std::vector<net::address> result;
+        for (const auto& info : infos)
+            result.push_back(info.addr);
+        return result;
+    }
+
+} // namespace
+
+
+pipeline::pipeline(unsigned burst) :
+    burst{burst}
+{}
+
+
+void
+pipeline::feed(const std::vector<net::address>& addresses)
+{
+    std::vector<net::address> fresh;
+    for (auto address : addresses)
+        if (seen.insert(address).second)
+            fresh.push_back(address);
+
+    for (auto address : scoreboard::rank(std::move(fresh))) {
+        if (scoreboard::is_dead(address)) {
+            reserves.push_back(address);
+            continue;
+        }
+        session.add(address, burst, scoreboard::expected_rtt(address));
+        ++fed;
+    }
+}
+
+
+void
+pipeline::use_reserves()
+{
+    for (auto address : reserves) {
+        if (fed >= ntp::min_cluster)
+            break;
+        session.add(address, burst, scoreboard::expected_rtt(address));
+        ++fed;
+    }
+    reserves.clear();
+}
+
+
+void
+pipeline::done_feeding()
+{
+    if (--feeders == 0) {
+        use_reserves();
+        session.close();
+    }
+}
+
+
+coro::task<void>
+resolve_stage(net::reactor& reactor,
+              std::shared_ptr<pipeline> pipe,
+              std::vector<std::string> names,
+              std::string service,
+              net::addrinfo::hints opts,
+              std::chrono::milliseconds timeout,
+              thread_pool& pool,
+              bool silent)
+{
+    using info_vec = std::vector<net::addrinfo::result>;
+
+    // Note: shared with the pool task, which may outlive this coroutine.
+    struct fallback {
+        std::string name;
+        std::atomic<bool> done = false;
+        std::optional<info_vec> answer;
+        std::string error;
+    };
+    std::vector<std::shared_ptr<fallback>> fallbacks;
+
+    // The pool tasks wake up the reactor when they finish; without it, poll them.
+    std::shared_ptr<net::notifier> wakeup;
+    try {
+        wakeup = std::make_shared<net::notifier>();
+    }
+    catch (std::exception& e) {
+        logger::printf("Can't create the DNS fallback notifier: %s\n", e.what());
+    }
+
+    try {
+        // Names the DNS servers didn't answer go to getaddrinfo() right away.
+        // Note: keep it short, getaddrinfo() still needs time if this fails.
+        co_await dns_cache::resolve(reactor, names, service, opts, std::min(timeout, 3000ms),
+                                    [&](const std::string& name,
+                                        const std::optional<info_vec>& answer)
+                                    {
+                                        if (answer) {
+                                            pipe->feed(addresses_of(*answer));
+                                            return;
+                                        }
+                                        auto f = std::make_shared<fallback>();
+                                        f->name = name;
+                                        fallbacks.push_back(f);
+                                        // Note: this runs on the reactor, the lookup must
+                                        // not run inline.
+                                        pool.enqueue([f, wakeup, service, opts]
+                                        {
+                                            try {
+                                                f->answer = dns_cache::refresh(f->name,
+                                                                               service,
+                                                                               opts);
+                                            }
+                                            catch (std::exception& e) {
+                                                f->error = e.what();
+                                            }
+                                            f->done = true;
+                                            if (wakeup)
+                                                wakeup->notify();
+                                        });
+                                    });
+
+        /*
+         * This is only reached when the DNS servers failed. The lookups that don't finish
+         * in time are left running, and reported as failed.
+         */
+        const auto deadline = net::reactor::clock::now() + timeout;
+        while (!fallbacks.empty()) {
+            for (auto it = fallbacks.begin(); it != fallbacks.end();) {
+                auto& f = **it;
+                if (!f.done) {
+                    ++it;
+                    continue;
+                }
+                if (f.answer)
+                    pipe->feed(addresses_of(*f.answer));
+                else if (!silent)
+                    notify::error(notify::level::verbose, "%s", f.error.data());
+                it = fallbacks.erase(it);
+            }
+            if (fallbacks.empty())
+                break;
+            auto now = net::reactor::clock::now();
+            if (now >= deadline) {
+                if (!silent)
+                    for (auto& f : fallbacks)
+                        notify::error(notify::level::verbose,
+                                      "%s: DNS lookup timed out.",
+                                      f->name.data());
+                break;
+            }
+            if (wakeup)
+                co_await wakeup->wait(reactor, deadline);
+            else
+                co_await reactor.sleep_until(std::min(deadline, now + 50ms));
+        }
+    }
+    catch (std::exception& e) {
+        if (!silent)
+            notify::error(notify::level::verbose, "%s", e.what());
+    }
+
+    pipe->done_feeding();
+}
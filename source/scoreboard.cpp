@@ -0,0 +1,283 @@
+/*
+ * Wii U Time Sync - A NTP client plugin for the Wii U.
+ *
+ * Copyright (C) 2025  Daniel K. O.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <algorithm>            // max(), min(), ranges::min_element(), ranges::stable_sort()
+#include <chrono>
+#include <cmath>                // abs()
+#include <map>
+#include <mutex>
+#include <sstream>
+
+#include <wupsxx/logger.hpp>
+#include <wupsxx/storage.hpp>
+
+#include "scoreboard.hpp"
+
+#include "utc.hpp"
+
+
+using namespace std::literals;
+
+namespace logger = wups::logger;
+
+
+namespace scoreboard {
+
+    namespace {
+
+        // How fast the moving averages follow new results.
+        constexpr double gain = 0.25;
+
+        // After this many consecutive failures, the address is skipped for a while.
+        constexpr unsigned max_failures = 3;
+
+        // How long a dead address is skipped; doubles with every failure after that.
+        constexpr std::chrono::seconds min_backoff = 1h;
+        constexpr std::chrono::seconds max_backoff = 24h;
+
+        // Addresses not seen for this long are forgotten; pool members come and go.
+        constexpr std::chrono::seconds max_age = 30 * 24h;
+
+        // Only the most recently seen addresses are kept, so storage stays small.
+        constexpr std::size_t max_entries = 64;
+
+        // Penalty for each stratum level, in seconds.
+        constexpr double stratum_cost = 0.005;
+
+
+        std::mutex mutex;
+
+        std::map<net::address, stats> entries;
+
+
+        double
+        now()
+        {
+            return utc::now().value.count();
+        }
+
+
+        bool
+        is_dead(const stats& s,
+                double t)
+            noexcept
+        {
+            if (s.failures < max_failures)
+                return false;
+            unsigned extra = std::min(s.failures - max_failures, 16u);
+            double backoff = std::min<double>(min_backoff.count() * (1u << extra),
+                                              max_backoff.count());
+            return t - s.last_failure < backoff;
+        }
+
+
+        // Roughly, the expected time wasted on this address; lower is better.
+        double
+        cost(const stats& s)
+            noexcept
+        {
+            return (s.rtt + 2 * s.jitter + s.stratum * stratum_cost)
+                / std::max(s.success, 0.05);
+        }
+
+
+        void
+        prune(double t)
+        {
+            std::erase_if(entries,
+                          [t](const auto& e)
+                          {
+                              return t - e.second.last_seen > max_age.count();
+                          });
+
+            while (entries.size() > max_entries) {
+                auto oldest = std::ranges::min_element(entries,
+                                                       {},
+                                                       [](const auto& e)
+                                                       {
+                                                           return e.second.last_seen;
+                                                       });
+                entries.erase(oldest);
+            }
+        }
+
+    } // namespace
+
+
+    void
+    load()
+        noexcept
+    {
+        std::lock_guard guard{mutex};
+        try {
+            entries.clear();
+            std::string data;
+            if (!wups::load("scoreboard", data))
+                return;
+
+            /*
+             * Stored as one line per address:
+             *     ip port success rtt jitter stratum failures last_failure last_seen rttvar
+             * where rttvar may be missing, from older versions.
+             */
+            std::istringstream in{data};
+            std::string line;
+            while (std::getline(in, line)) {
+                std::istringstream fields{line};
+                net::address addr;
+                stats s;
+                if (!(fields >> addr.ip >> addr.port
+                             >> s.success >> s.rtt >> s.jitter >> s.stratum
+                             >> s.failures >> s.last_failure >> s.last_seen))
+                    continue;
+                if (!(fields >> s.rttvar))
+                    s.rttvar = s.rtt / 2;
+                entries[addr] = s;
+            }
+        }
+        catch (std::exception& e) {
+            logger::printf("Error in scoreboard::load(): %s\n", e.what());
+            entries.clear();
+        }
+    }
+
+
+    std::optional<stats>
+    find(net::address addr)
+    {
+        std::lock_guard guard{mutex};
+        auto it = entries.find(addr);
+        if (it == entries.end())
+            return {};
+        return it->second;
+    }
+
+
+    std::optional<std::chrono::milliseconds>
+    expected_rtt(net::address addr)
+    {
+        std::lock_guard guard{mutex};
+        auto it = entries.find(addr);
+        // Note: entries created by a failure only have the default RTT.
+        if (it == entries.end() || it->second.failures)
+            return {};
+        using time_utils::dbl_seconds;
+        return std::chrono::duration_cast<std::chrono::milliseconds>(
+            dbl_seconds{it->second.rtt});
+    }
+
+
+    void
+    success(net::address addr,
+            const ntp::clock_filter& filter)
+    {
+        std::lock_guard guard{mutex};
+        auto [it, inserted] = entries.try_emplace(addr);
+        auto& s = it->second;
+        if (inserted) {
+            // Note: the first measurement replaces the defaults, instead of averaging.
+            s.success = 1;
+            s.rtt = filter.delay().count();
+            s.rttvar = s.rtt / 2;
+            s.jitter = filter.jitter().count();
+        } else {
+            // Note: like RFC 6298, the deviation is updated with the previous average.
+            double rtt = filter.delay().count();
+            s.success += gain * (1 - s.success);
+            s.rttvar += gain * (std::abs(rtt - s.rtt) - s.rttvar);
+            s.rtt += gain * (rtt - s.rtt);
+            s.jitter += gain * (filter.jitter().count() - s.jitter);
+        }
+        s.stratum = filter.best().stratum;
+        s.failures = 0;
+        s.last_seen = now();
+    }
+
+
+    void
+    failure(net::address addr)
+    {
+        std::lock_guard guard{mutex};
+        auto& s = entries[addr];
+        s.success -= gain * s.success;
+        ++s.failures;
+        s.last_failure = s.last_seen = now();
+    }
+
+
+    void
+    store()
+    {
+        std::lock_guard guard{mutex};
+        prune(now());
+
+        std::ostringstream out;
+        out.precision(17);
+        for (const auto& [addr, s] : entries)
+            out << addr.ip << ' ' << addr.port
+                << ' ' << s.success << ' ' << s.rtt << ' ' << s.jitter
+                << ' ' << s.stratum << ' ' << s.failures
+                << ' ' << s.last_failure << ' ' << s.last_seen
+                << ' ' << s.rttvar << '\n';
+
+        logger::guard lguard;
+        try {
+            wups::store("scoreboard", out.str());
+            wups::save();
+        }
+        catch (std::exception& e) {
+            logger::printf("Error in scoreboard::store(): %s\n", e.what());
+        }
+    }
+
+
+    bool
+    is_dead(net::address addr)
+    {
+        std::lock_guard guard{mutex};
+        auto it = entries.find(addr);
+        return it != entries.end() && is_dead(it->second, now());
+    }
+
+
+    std::vector<net::address>
+    rank(std::vector<net::address> addrs)
+    {
+        struct ranked {
+            net::address addr;
+            bool dead;
+            double cost;
+        };
+
+        std::vector<ranked> items;
+        items.reserve(addrs.size());
+        {
+            std::lock_guard guard{mutex};
+            double t = now();
+            for (auto addr : addrs) {
+                auto it = entries.find(addr);
+                const stats s = it == entries.end() ? stats{} : it->second;
+                items.push_back({ addr, is_dead(s, t), cost(s) });
+            }
+        }
+
+        // Note: stable, so ties keep the order the DNS server gave.
+        std::ranges::stable_sort(items,
+                                 [](const ranked& a, const ranked& b)
+                                 {
+                                     if (a.dead != b.dead)
+                                         return b.dead;
+                                     return a.cost < b.cost;
+                                 });
+
+        for (std::size_t i = 0; i < items.size(); ++i)
+            addrs[i] = items[i].addr;
+        return addrs;
+    }
+
+} // namespace scoreboard
@@ -16,6 +16,7 @@
 
 #include "cfg.hpp"
 #include "core.hpp"
+#include "executor.hpp"
 
 
 using namespace std::literals;
@@ -55,9 +56,8 @@ synchronize_item::on_started()
         }
     };
 
-    task_result = std::async(std::launch::async,
-                             std::move(task),
-                             task_stopper.get_token());
+    task_result = executor::submit(std::move(task),
+                                   task_stopper.get_token());
 }
 
 
@@ -6,37 +6,195 @@
  * SPDX-License-Identifier: MIT
  */
 
+#include <algorithm>            // min()
+#include <thread>               // this_thread::sleep_for()
+
 #include "thread_pool.hpp"
 
 
+using namespace std::literals;
+
+
+thread_local thread_pool* thread_pool::current = nullptr;
+thread_local thread_pool::worker* thread_pool::current_worker = nullptr;
+
+
 void
-thread_pool::worker_thread(std::stop_token token)
+thread_pool::worker_thread(std::stop_token token,
+                           worker& self)
 {
+    current = this;
+    current_worker = &self;
     try {
         while (!token.stop_requested()) {
-            auto task = tasks.pop();
+            auto task = next_task(token, self);
+            if (!task)
+                continue; // just a wake-up
+            --num_queued;
             --num_idle_workers;
-            task();
+            task->run();
             ++num_idle_workers;
         }
     }
-    catch (async_queue<task_type>::stop_request& r) {}
+    catch (task_queue::stop_request& r) {}
+
+    // Nobody else can push to this deque, hand whatever is left to the other workers.
+    while (task_type t = self.local.take()) {
+        // If the queue is full, we can't wait for a free slot: there may be no workers left.
+        if (!tasks.try_push(t)) {
+            --num_queued;
+            t->run();
+        }
+    }
+
+    --num_idle_workers;
+    current_worker = nullptr;
+    current = nullptr;
+
+    auto expected = worker::state::running;
+    if (!self.status.compare_exchange_strong(expected, worker::state::exited)) {
+        // Detached by release_workers(). Note: the pool may be destroyed right after this.
+        --num_detached;
+    }
+}
+
+
+// Own deque first, then the shared queue, then steal; only then sleep.
+thread_pool::task_type
+thread_pool::next_task(std::stop_token token,
+                       worker& self)
+{
+    if (task_type t = self.local.take())
+        return t;
+
+    if (auto t = tasks.try_pop())
+        return *t;
+
+    if (auto t = steal(self))
+        return t;
+
+    return tasks.pop(token);
+}
+
+
+thread_pool::task_type
+thread_pool::steal(const worker& thief)
+{
+    for (auto& slot : slots) {
+        worker* w = slot.load(std::memory_order_acquire);
+        if (!w || w == &thief)
+            continue;
+        if (task_type t = w->local.steal())
+            return t;
+    }
+    return nullptr;
 }
 
 
+// Note: must be called with workers_mutex locked.
 void
 thread_pool::add_worker()
 {
-    // Obey the limit.
+    // Obey the limit; other threads may have added workers since it was checked.
     if (workers.size() >= max_workers)
         return;
     ++num_idle_workers;
-    workers.emplace_back([this](std::stop_token token) { worker_thread(token); });
+    auto w = std::make_unique<worker>();
+    w->thread = std::jthread{
+        [this, &self = *w](std::stop_token token) { worker_thread(token, self); }
+    };
+    slots[workers.size()].store(w.get(), std::memory_order_release);
+    workers.push_back(std::move(w));
+    num_workers = workers.size();
+}
+
+
+// Only locks workers_mutex when a worker must be added.
+void
+thread_pool::grow_if_needed()
+{
+    if (num_workers < max_workers) {
+        std::lock_guard guard{workers_mutex};
+        add_worker();
+    }
+}
+
+
+thread_pool::dispatch
+thread_pool::prepare_dispatch()
+{
+    if (max_workers == 0)
+        return dispatch::caller; // If no worker will handle this, execute it immediately.
+
+    // If the idle threads already have queued tasks to pick up, try to add another.
+    if (num_idle_workers <= num_queued) {
+        if (num_workers < max_workers)
+            grow_if_needed();
+        else if (current == this && num_idle_workers == 0)
+            return dispatch::caller;
+    }
+
+    ++num_queued;
+    return current == this ? dispatch::local : dispatch::shared;
+}
+
+
+void
+thread_pool::push_local(task_type task)
+{
+    current_worker->local.push(task);
+    // Idle workers sleep on the shared queue, wake one up so it can steal this task.
+    // If the queue is full, there's already enough to wake them up.
+    if (num_idle_workers > 0)
+        tasks.try_push(nullptr);
+}
+
+
+void
+thread_pool::dispatch_task(task_type task)
+{
+    switch (prepare_dispatch()) {
+        case dispatch::caller:
+            task->run();
+            break;
+        case dispatch::local:
+            push_local(task);
+            break;
+        case dispatch::shared:
+            tasks.push(task);
+            break;
+    }
+}
+
+
+void
+thread_pool::enqueue_task(task_type task)
+{
+    // Same as prepare_dispatch(), but it never falls back to the caller.
+    if (num_idle_workers <= num_queued)
+        grow_if_needed();
+    ++num_queued;
+    if (!tasks.try_push(task)) {
+        --num_queued;
+        task->abandon();
+    }
+}
+
+
+bool
+thread_pool::run_local()
+{
+    task_type t = current_worker->local.take();
+    if (!t)
+        return false;
+    --num_queued;
+    t->run();
+    return true;
 }
 
 
 thread_pool::thread_pool(unsigned max_workers) :
-    max_workers{max_workers}
+    max_workers{std::min(max_workers, max_threads)}
 {}
 
 
@@ -46,6 +204,88 @@ thread_pool::~thread_pool()
     // tasks_queue::stop_request{}.
     tasks.stop();
 
-    // The jthread destructor will also notify the stop token, so we don't need to do
-    // anything else.
+    // Join them here, the queue must outlive the workers.
+    release_workers();
+
+    // The detached workers still use the queue and counters, until they exit.
+    // Note: polled, a notify_all() after the decrement could touch a destroyed pool.
+    while (num_detached)
+        std::this_thread::sleep_for(1ms);
+
+    // Whatever is left will never run.
+    tasks.reset();
+    while (auto t = tasks.try_pop())
+        if (*t)
+            (*t)->abandon();
+}
+
+
+void
+thread_pool::resize(unsigned new_max_workers)
+{
+    std::lock_guard guard{workers_mutex};
+    max_workers = std::min(new_max_workers, max_threads);
+    while (workers.size() > max_workers) {
+        workers.back()->thread.request_stop();
+        // Note: a retired worker can still be robbed, until it stops.
+        retired.push_back(std::move(workers.back()));
+        workers.pop_back();
+        slots[workers.size()].store(nullptr, std::memory_order_release);
+    }
+    num_workers = workers.size();
+}
+
+
+std::size_t
+thread_pool::release_workers(std::optional<std::chrono::milliseconds> timeout)
+{
+    std::vector<std::unique_ptr<worker>> stopping;
+    {
+        std::lock_guard guard{workers_mutex};
+        stopping = std::move(workers);
+        workers.clear();
+        for (auto& slot : slots)
+            slot.store(nullptr, std::memory_order_release);
+        num_workers = 0;
+        for (auto& w : retired)
+            stopping.push_back(std::move(w));
+        retired.clear();
+    }
+
+    // Join them all without holding the lock, before destroying any of them: a worker
+    // that is still running may be stealing from another one.
+    for (auto& w : stopping)
+        w->thread.request_stop();
+
+    std::size_t detached = 0;
+    if (timeout) {
+        auto deadline = std::chrono::steady_clock::now() + *timeout;
+        for (auto& w : stopping) {
+            while (w->status == worker::state::running
+                   && std::chrono::steady_clock::now() < deadline)
+                std::this_thread::sleep_for(1ms);
+            ++num_detached;
+            auto expected = worker::state::running;
+            if (!w->status.compare_exchange_strong(expected, worker::state::abandoned)) {
+                --num_detached;
+                continue;
+            }
+            // Its deque can still be robbed; the worker itself won't look at it until it
+            // returns from the stuck task.
+            while (task_type t = w->local.steal())
+                if (!tasks.try_push(t)) {
+                    --num_queued;
+                    t->abandon();
+                }
+            w->thread.detach();
+            ++detached;
+            std::lock_guard guard{workers_mutex};
+            abandoned.push_back(std::move(w));
+        }
+    }
+
+    for (auto& w : stopping)
+        if (w)
+            w->thread.join();
+    return detached;
 }
@@ -31,4 +31,26 @@ namespace utc {
         return timestamp{ local_time() - cfg::utc_offset.value };
     }
 
+
+    std::int64_t
+    system_ticks_offset()
+        noexcept
+    {
+        using std::chrono::seconds;
+        // Note: OSGetTime() is the system time plus a bias, set along with the clock.
+        std::int64_t local_offset = OSGetTime() - OSGetSystemTime();
+        std::int64_t tz_ticks = seconds{cfg::utc_offset.value}.count()
+                              * static_cast<std::int64_t>(OSTimerClockSpeed);
+        return local_offset - tz_ticks;
+    }
+
+
+
+    clock_anchor
+    make_anchor(std::int64_t system_ticks)
+        noexcept
+    {
+        return { system_ticks, system_ticks + OSGetTime() - OSGetSystemTime() };
+    }
+
 } // namespace utc
@@ -6,7 +6,9 @@
  * SPDX-License-Identifier: MIT
  */
 
+#include <condition_variable>
 #include <iterator>             // distance()
+#include <mutex>
 #include <stdexcept>            // logic_error, runtime_error
 
 #include <nn/ac.h>
@@ -88,6 +90,23 @@ namespace utils {
     } // namespace
 
 
+    bool
+    wait_until(std::stop_token token,
+               std::chrono::steady_clock::time_point deadline)
+    {
+        /*
+         * Nobody ever notifies this condition variable; it only wakes up at the deadline,
+         * or through the stop callback that wait_until() registers on the token.
+         */
+        static std::mutex mutex;
+        static std::condition_variable_any cond;
+
+        std::unique_lock lock{mutex};
+        cond.wait_until(lock, token, deadline, [] { return false; });
+        return !token.stop_requested();
+    }
+
+
     exec_guard::exec_guard(std::atomic<bool>& f) :
         flag(f),
         guarded{false}
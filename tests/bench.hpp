@@ -0,0 +1,71 @@
+#ifndef BENCH_HPP
+#define BENCH_HPP
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <vector>
+
+
+// Minimal benchmark helpers: time a function many times, and print the distribution.
+
+namespace bench {
+
+    using clock = std::chrono::steady_clock;
+    using micros = std::chrono::duration<double, std::micro>;
+
+
+    struct stats {
+        double median;
+        double p99;
+        double max;
+    };
+
+
+    inline
+    stats
+    summarize(std::vector<double> samples)
+    {
+        if (samples.empty())
+            return {};
+        std::ranges::sort(samples);
+        auto at = [&](double q) { return samples[static_cast<std::size_t>(q * (samples.size() - 1))]; };
+        return { at(0.5), at(0.99), samples.back() };
+    }
+
+
+    // Prints one line: the label, then the median, 99th percentile and maximum, in µs.
+    inline
+    void
+    report(const char* label,
+           const stats& s)
+    {
+        std::printf("  %-40s median %10.2f µs   p99 %10.2f µs   max %10.2f µs\n",
+                    label, s.median, s.p99, s.max);
+    }
+
+
+    // Run func() `rounds` times, after a few warm-up rounds, and report each round's time.
+    template<typename Func>
+    stats
+    run(const char* label,
+        unsigned rounds,
+        Func func)
+    {
+        for (unsigned i = 0; i < rounds / 10 + 1; ++i)
+            func();
+        std::vector<double> samples;
+        samples.reserve(rounds);
+        for (unsigned i = 0; i < rounds; ++i) {
+            auto start = clock::now();
+            func();
+            samples.push_back(micros{clock::now() - start}.count());
+        }
+        auto s = summarize(std::move(samples));
+        report(label, s);
+        return s;
+    }
+
+} // namespace bench
+
+#endif
@@ -0,0 +1,81 @@
+/*
+ * Contention benchmark: the lock-free mpmc_ring specialization of async_queue against
+ * the mutex-based one, with several producers and consumers moving items through one
+ * queue, using the blocking push() and pop().
+ *
+ * The mutex-based queue is unbounded, so its producers never block; the ring is also
+ * measured with a capacity large enough to rarely fill up.
+ */
+
+#include <cstdint>
+#include <cstdio>
+#include <thread>
+#include <utility>              // pair<>
+#include <vector>
+
+#include "async_queue.hpp"
+#include "mpmc_ring.hpp"
+
+#include "bench.hpp"
+
+
+namespace {
+
+    constexpr unsigned items = 100'000;
+
+
+    template<typename Queue>
+    void
+    contend(const char* label,
+            unsigned producers,
+            unsigned consumers)
+    {
+        auto s = bench::run(label, 20, [&]
+        {
+            Queue queue;
+            std::vector<std::jthread> threads;
+            for (unsigned p = 0; p < producers; ++p)
+                threads.emplace_back([&, p]
+                {
+                    for (unsigned i = p; i < items; i += producers)
+                        queue.push(i + 1);
+                });
+            for (unsigned c = 0; c < consumers; ++c)
+                threads.emplace_back([&, c]
+                {
+                    // Note: 0 is only pushed after all items, one per consumer.
+                    try {
+                        while (queue.pop())
+                            ;
+                    }
+                    catch (typename Queue::stop_request&) {}
+                });
+            for (unsigned p = 0; p < producers; ++p)
+                threads[p].join();
+            for (unsigned c = 0; c < consumers; ++c)
+                queue.push(0);
+        });
+        std::printf("  %-40s %10.0f items/s\n", label, items / s.median * 1e6);
+    }
+
+} // namespace
+
+
+int
+main()
+{
+    using ring_queue = async_queue<std::uint32_t, mpmc_ring<std::uint32_t, 64>>;
+    using big_ring_queue = async_queue<std::uint32_t, mpmc_ring<std::uint32_t, 4096>>;
+    using mutex_queue = async_queue<std::uint32_t>;
+
+    // Note: with fewer CPUs than threads, this mostly measures how the blocked threads
+    // are woken up, not contention.
+    std::printf("bench_async_queue: %u items per round, %u CPU(s)\n", items,
+                std::thread::hardware_concurrency());
+    for (auto [p, c] : { std::pair{1u, 1u}, {2u, 2u}, {4u, 4u}, {1u, 4u}, {4u, 1u} }) {
+        std::printf("%u producer(s), %u consumer(s):\n", p, c);
+        contend<ring_queue>("mpmc_ring, 64 slots", p, c);
+        contend<big_ring_queue>("mpmc_ring, 4096 slots", p, c);
+        contend<mutex_queue>("mutex + std::queue", p, c);
+    }
+}
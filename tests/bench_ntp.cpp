@@ -0,0 +1,150 @@
+/*
+ * Benchmark: the NTP offset and round-trip delay of a sample, computed with the
+ * fixed-point ntp::duration arithmetic, against the previous double path (each timestamp
+ * converted with ldexp(), then the era wraparound patched with half_era/quarter_era).
+ */
+
+#include <algorithm>            // max()
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "ntp.hpp"
+
+#include "bench.hpp"
+
+
+using ntp::dbl_seconds;
+
+
+namespace {
+
+    struct stamps {
+        ntp::timestamp t1, t2, t3, t4;
+    };
+
+
+    struct result {
+        dbl_seconds offset;
+        dbl_seconds delay;
+    };
+
+
+    result
+    fixed_point(const stamps& s)
+    {
+        ntp::duration roundtrip = (s.t4 - s.t1) - (s.t3 - s.t2);
+        ntp::duration offset = ((s.t2 - s.t1) + (s.t3 - s.t4)).half();
+        return { static_cast<dbl_seconds>(offset), static_cast<dbl_seconds>(roundtrip) };
+    }
+
+
+    result
+    double_path(const stamps& s)
+    {
+        auto d1 = static_cast<dbl_seconds>(s.t1);
+        auto d2 = static_cast<dbl_seconds>(s.t2);
+        auto d3 = static_cast<dbl_seconds>(s.t3);
+        auto d4 = static_cast<dbl_seconds>(s.t4);
+
+        constexpr dbl_seconds half_era{0x1.0p32};
+        constexpr dbl_seconds quarter_era{0x1.0p31};
+        if (d4 < d1)
+            d4 += half_era;
+        if (d3 < d2)
+            d3 += half_era;
+
+        dbl_seconds roundtrip = (d4 - d1) - (d3 - d2);
+        dbl_seconds correction = d3 + roundtrip / 2.0 - d4;
+        if (correction > quarter_era)
+            correction -= half_era;
+        if (correction < -quarter_era)
+            correction += half_era;
+        return { correction, roundtrip };
+    }
+
+
+    ntp::timestamp
+    make(std::uint64_t raw)
+    {
+        ntp::timestamp t;
+        t.store(raw);
+        return t;
+    }
+
+
+    // Samples around `base` (raw u32.32), with offsets up to a minute and delays up to 1 s.
+    std::vector<stamps>
+    samples(std::uint64_t base,
+            std::size_t n)
+    {
+        std::mt19937_64 rng{42};
+        std::uniform_int_distribution<std::int64_t> offset(-60LL << 32, 60LL << 32);
+        std::uniform_int_distribution<std::uint64_t> delay(0, 1ULL << 31);
+        std::vector<stamps> result;
+        for (std::size_t i = 0; i < n; ++i) {
+            std::uint64_t t1 = base + (rng() >> 32);
+            std::uint64_t t2 = t1 + offset(rng) + delay(rng);
+            std::uint64_t t3 = t2 + delay(rng) / 64;
+            std::uint64_t t4 = t1 + delay(rng) * 2 + (t3 - t2);
+            result.push_back({ make(t1), make(t2), make(t3), make(t4) });
+        }
+        return result;
+    }
+
+
+    template<typename Func>
+    void
+    time_path(const char* label,
+              const std::vector<stamps>& input,
+              Func func)
+    {
+        volatile double sink = 0;
+        auto s = bench::run(label, 200, [&]
+        {
+            double sum = 0;
+            for (const auto& st : input) {
+                auto r = func(st);
+                sum += r.offset.count() + r.delay.count();
+            }
+            sink = sink + sum;
+        });
+        std::printf("  %-40s %10.2f ns/sample\n", label, s.median * 1000 / input.size());
+    }
+
+
+    void
+    compare(const char* title,
+            std::uint64_t base)
+    {
+        constexpr std::size_t n = 4096;
+        auto input = samples(base, n);
+
+        std::printf("%s:\n", title);
+        time_path("fixed-point ntp::duration", input, fixed_point);
+        time_path("double, ldexp() + era fix-ups", input, double_path);
+
+        // How far apart the two paths are; the double path loses fractional bits.
+        double max_diff = 0;
+        for (const auto& st : input) {
+            auto a = fixed_point(st);
+            auto b = double_path(st);
+            max_diff = std::max(max_diff, std::abs((a.offset - b.offset).count()));
+        }
+        std::printf("  %-40s %10.3g s\n", "largest offset difference", max_diff);
+    }
+
+} // namespace
+
+
+int
+main()
+{
+    std::printf("bench_ntp: %u samples per round\n", 4096u);
+    // 2025, in Era 0.
+    compare("Era 0", 3'944'678'400ULL << 32);
+    // Straddling the Era 0 -> Era 1 rollover, in 2036.
+    compare("Era rollover", static_cast<std::uint64_t>(-(30LL << 32)));
+}
@@ -0,0 +1,126 @@
+/*
+ * Benchmark: resolving a batch of names with net::resolver, all through one socket on the
+ * reactor, against the previous design, one blocking lookup per name on a pool thread.
+ *
+ * Both ask the local stand-in DNS server, so this measures the overhead of each design,
+ * not the network.
+ */
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "net/resolver.hpp"
+#include "thread_pool.hpp"
+
+#include "bench.hpp"
+#include "servers.hpp"
+
+
+using namespace std::literals;
+
+
+namespace {
+
+    constexpr unsigned rounds = 200;
+    constexpr unsigned pool_size = 4;
+
+
+    // What a blocking lookup does: one socket, one query, wait for the matching reply.
+    bool
+    blocking_query(const net::address& server,
+                   const std::string& name,
+                   std::uint16_t id)
+    {
+        std::vector<std::uint8_t> msg;
+        servers::put16(msg, id);
+        servers::put16(msg, 0x0100); // recursion desired
+        servers::put16(msg, 1);
+        servers::put16(msg, 0);
+        servers::put16(msg, 0);
+        servers::put16(msg, 0);
+        auto qname = servers::encode_name(name);
+        msg.insert(msg.end(), qname.begin(), qname.end());
+        servers::put16(msg, 1); // A
+        servers::put16(msg, 1); // IN
+
+        int fd = socket(AF_INET, SOCK_DGRAM, 0);
+        timeval tv{1, 0};
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof tv);
+        sockaddr_in sa{};
+        sa.sin_family = AF_INET;
+        sa.sin_addr.s_addr = htonl(server.ip);
+        sa.sin_port = htons(server.port);
+        sendto(fd, msg.data(), msg.size(), 0, reinterpret_cast<sockaddr*>(&sa), sizeof sa);
+
+        bool ok = false;
+        std::uint8_t buf[512];
+        for (;;) {
+            auto size = recv(fd, buf, sizeof buf, 0);
+            if (size < 2)
+                break;
+            if (((buf[0] << 8) | buf[1]) == id) {
+                ok = true;
+                break;
+            }
+        }
+        close(fd);
+        return ok;
+    }
+
+
+    void
+    compare(const servers::dns_server& server,
+            thread_pool& pool,
+            unsigned num_names)
+    {
+        std::printf("%u name(s):\n", num_names);
+
+        std::string label = "net::resolver, one socket";
+        bench::run(label.c_str(), rounds, [&]
+        {
+            net::resolver res{{server.addr}};
+            for (unsigned i = 0; i < num_names; ++i)
+                res.add("a.test");
+            net::reactor reactor;
+            auto results = *reactor.run({}, res.run(reactor, 2s));
+            for (auto& r : results)
+                if (!r)
+                    std::fprintf(stderr, "resolver failed: %s\n", r.error().c_str());
+        });
+
+        label = "blocking, " + std::to_string(pool_size) + " pool threads";
+        bench::run(label.c_str(), rounds, [&]
+        {
+            std::vector<task_future<bool>> futures;
+            for (unsigned i = 0; i < num_names; ++i)
+                futures.push_back(pool.submit(blocking_query, server.addr, "a.test"s,
+                                              static_cast<std::uint16_t>(i)));
+            for (auto& f : futures)
+                if (!f.get())
+                    std::fprintf(stderr, "blocking query failed\n");
+        });
+    }
+
+} // namespace
+
+
+int
+main()
+{
+    servers::dns_server server;
+    thread_pool pool{pool_size};
+
+    std::printf("bench_resolver: time to resolve a batch of names\n");
+    for (unsigned n : { 1, 8, 32 })
+        compare(server, pool, n);
+
+    pool.release_workers();
+    task_state_pools::drain_all();
+}
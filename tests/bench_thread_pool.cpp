@@ -0,0 +1,160 @@
+/*
+ * Benchmark: thread_pool (per-worker work-stealing deques, lock-free shared ring) against
+ * the previous design, a single mutex-protected async_queue of std::move_only_function,
+ * with std::packaged_task futures.
+ *
+ * - throughput: many tiny tasks submitted from outside the pool;
+ * - nested: tasks that submit follow-up tasks, like a DNS lookup starting NTP queries;
+ * - latency: the time from submit() until the task starts running.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <functional>
+#include <future>
+#include <latch>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "async_queue.hpp"
+#include "thread_pool.hpp"
+
+#include "bench.hpp"
+
+
+namespace {
+
+    // The previous design, reduced to what's measured here.
+    class mutex_pool {
+
+        async_queue<std::move_only_function<void()>> tasks;
+        std::vector<std::jthread> workers;
+
+    public:
+
+        explicit
+        mutex_pool(unsigned n)
+        {
+            for (unsigned i = 0; i < n; ++i)
+                workers.emplace_back([this]
+                {
+                    try {
+                        for (;;)
+                            tasks.pop()();
+                    }
+                    catch (decltype(tasks)::stop_request&) {}
+                });
+        }
+
+
+        ~mutex_pool()
+        {
+            tasks.stop();
+        }
+
+
+        template<typename Func>
+        std::future<std::invoke_result_t<Func>>
+        submit(Func func)
+        {
+            std::packaged_task<std::invoke_result_t<Func>()> task{std::move(func)};
+            auto future = task.get_future();
+            tasks.push(std::move_only_function<void()>{std::move(task)});
+            return future;
+        }
+
+    };
+
+
+    const unsigned num_workers = std::clamp(std::thread::hardware_concurrency(), 2u,
+                                            thread_pool::max_threads);
+
+
+    template<typename Pool>
+    void
+    throughput(const char* label,
+               Pool& pool)
+    {
+        constexpr unsigned batch = 10'000;
+        std::atomic<unsigned> sink = 0;
+        auto s = bench::run(label, 50, [&]
+        {
+            std::latch done{batch};
+            for (unsigned i = 0; i < batch; ++i)
+                pool.submit([&] { ++sink; done.count_down(); });
+            done.wait();
+        });
+        std::printf("  %-40s %10.0f tasks/s\n", label, batch / s.median * 1e6);
+    }
+
+
+    template<typename Pool>
+    void
+    nested(const char* label,
+           Pool& pool)
+    {
+        constexpr unsigned outer = 64;
+        constexpr unsigned inner = 8;
+        bench::run(label, 200, [&]
+        {
+            std::latch done{outer * inner};
+            for (unsigned i = 0; i < outer; ++i)
+                pool.submit([&]
+                {
+                    for (unsigned j = 0; j < inner; ++j)
+                        pool.submit([&] { done.count_down(); });
+                });
+            done.wait();
+        });
+    }
+
+
+    template<typename Pool>
+    void
+    latency(const char* label,
+            Pool& pool)
+    {
+        constexpr unsigned burst = 64;
+        std::vector<double> samples;
+        for (unsigned r = 0; r < 200; ++r) {
+            std::vector<bench::clock::time_point> submitted(burst), started(burst);
+            std::latch done{burst};
+            for (unsigned i = 0; i < burst; ++i) {
+                submitted[i] = bench::clock::now();
+                pool.submit([&, i] { started[i] = bench::clock::now(); done.count_down(); });
+            }
+            done.wait();
+            for (unsigned i = 0; i < burst; ++i)
+                samples.push_back(bench::micros{started[i] - submitted[i]}.count());
+        }
+        bench::report(label, bench::summarize(std::move(samples)));
+    }
+
+} // namespace
+
+
+int
+main()
+{
+    std::printf("bench_thread_pool: %u workers\n", num_workers);
+
+    thread_pool stealing{num_workers};
+    mutex_pool locked{num_workers};
+
+    std::printf("throughput, 10000 tasks per round:\n");
+    throughput("thread_pool", stealing);
+    throughput("mutex async_queue", locked);
+
+    std::printf("nested, 64 tasks submitting 8 each:\n");
+    nested("thread_pool", stealing);
+    nested("mutex async_queue", locked);
+
+    std::printf("submit-to-start latency, bursts of 64:\n");
+    latency("thread_pool", stealing);
+    latency("mutex async_queue", locked);
+
+    stealing.release_workers();
+    task_state_pools::drain_all();
+}
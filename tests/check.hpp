@@ -0,0 +1,32 @@
+#ifndef CHECK_HPP
+#define CHECK_HPP
+
+#include <cstdio>
+
+
+// Minimal test helpers: CHECK() reports the failure and keeps going.
+
+inline int check_failures = 0;
+
+#define CHECK(cond)                                                     \
+    do {                                                                \
+        if (!(cond)) {                                                  \
+            std::fprintf(stderr, "%s:%d: CHECK(%s) failed\n",           \
+                         __FILE__, __LINE__, #cond);                    \
+            ++check_failures;                                           \
+        }                                                               \
+    } while (false)
+
+
+inline
+int
+check_result(const char* name)
+{
+    if (check_failures)
+        std::fprintf(stderr, "%s: %d check(s) failed\n", name, check_failures);
+    else
+        std::printf("%s: ok\n", name);
+    return check_failures ? 1 : 0;
+}
+
+#endif
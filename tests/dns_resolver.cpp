@@ -0,0 +1,73 @@
+/*
+ * net::resolver against a local stand-in DNS server: answers, errors, retransmissions,
+ * and forged replies that must be ignored.
+ */
+
+#include <algorithm>            // ranges::sort(), ranges::unique()
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "net/resolver.hpp"
+
+#include "check.hpp"
+#include "servers.hpp"
+
+
+using namespace std::literals;
+
+using servers::ip_a1;
+using servers::ip_a2;
+using servers::ip_good;
+
+
+int
+main()
+{
+    servers::dns_server server;
+
+    net::resolver res{{server.addr}};
+    auto a = res.add("a.test");
+    auto missing = res.add("missing.test");
+    auto spoofed = res.add("spoofed.test");
+    auto lossy = res.add("lossy.test");
+    auto invalid = res.add("bad..name");
+
+    std::vector<unsigned> callbacks(5);
+    res.set_callback([&](std::size_t i, const net::resolver::outcome&) { ++callbacks.at(i); });
+
+    net::reactor reactor;
+    auto results = *reactor.run({}, res.run(reactor, 2s, 100ms));
+    CHECK(results.size() == 5);
+
+    CHECK(results[a]);
+    if (results[a]) {
+        CHECK((results[a]->addresses == std::vector<std::uint32_t>{ip_a1, ip_a2}));
+        CHECK(results[a]->ttl == 60s); // the smallest one
+    }
+
+    CHECK(!results[missing]);
+
+    CHECK(results[spoofed]);
+    if (results[spoofed])
+        CHECK(results[spoofed]->addresses == std::vector<std::uint32_t>{ip_good});
+
+    CHECK(results[lossy]); // answered on the retransmission
+    CHECK(!results[invalid]);
+
+    for (auto n : callbacks)
+        CHECK(n == 1);
+
+    // Query IDs are random, not a counter.
+    auto ids = server.seen_ids();
+    std::ranges::sort(ids);
+    auto last = std::ranges::unique(ids);
+    ids.erase(last.begin(), last.end());
+    CHECK(ids.size() >= 4);
+    bool sequential = true;
+    for (std::size_t i = 1; i < ids.size(); ++i)
+        sequential = sequential && ids[i] == ids[i - 1] + 1;
+    CHECK(!sequential);
+
+    return check_result("dns_resolver");
+}
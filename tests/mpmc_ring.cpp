@@ -0,0 +1,95 @@
+/*
+ * mpmc_ring: with several producers and consumers, every element arrives exactly once,
+ * and elements left in the ring are destroyed with it. Meant to run under the thread
+ * sanitizer.
+ */
+
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "mpmc_ring.hpp"
+
+#include "check.hpp"
+
+
+namespace {
+
+    void
+    single_thread()
+    {
+        mpmc_ring<int, 4> ring;
+        CHECK(!ring.try_pop());
+        for (int i = 0; i < 4; ++i)
+            CHECK(ring.try_push(int{i}));
+        CHECK(!ring.try_push(4)); // full
+        for (int i = 0; i < 4; ++i) {
+            auto x = ring.try_pop();
+            CHECK(x && *x == i); // in order
+        }
+        CHECK(!ring.try_pop());
+
+        // Whatever is left is destroyed along with the ring.
+        auto tracked = std::make_shared<int>(0);
+        {
+            mpmc_ring<std::shared_ptr<int>, 4> owners;
+            CHECK(owners.try_push(std::shared_ptr{tracked}));
+            CHECK(owners.try_push(std::shared_ptr{tracked}));
+            CHECK(tracked.use_count() == 3);
+        }
+        CHECK(tracked.use_count() == 1);
+    }
+
+
+    void
+    contended()
+    {
+        constexpr int producers = 4;
+        constexpr int consumers = 4;
+        constexpr int per_producer = 50'000;
+        constexpr int count = producers * per_producer;
+
+        mpmc_ring<int, 64> ring;
+        std::vector<std::atomic<int>> seen(count);
+        std::atomic<int> consumed = 0;
+
+        std::vector<std::jthread> threads;
+        for (int c = 0; c < consumers; ++c)
+            threads.emplace_back([&]
+            {
+                while (consumed.load(std::memory_order_relaxed) < count)
+                    if (auto x = ring.try_pop()) {
+                        seen[*x].fetch_add(1, std::memory_order_relaxed);
+                        consumed.fetch_add(1, std::memory_order_relaxed);
+                    }
+            });
+        for (int p = 0; p < producers; ++p)
+            threads.emplace_back([&, p]
+            {
+                for (int i = p * per_producer; i < (p + 1) * per_producer; ++i)
+                    while (!ring.try_push(int{i}))
+                        std::this_thread::yield();
+            });
+        threads.clear();
+
+        int missing = 0;
+        int duplicated = 0;
+        for (auto& s : seen) {
+            missing += s == 0;
+            duplicated += s > 1;
+        }
+        CHECK(missing == 0);
+        CHECK(duplicated == 0);
+    }
+
+} // namespace
+
+
+int
+main()
+{
+    single_thread();
+    contended();
+    return check_result("mpmc_ring");
+}
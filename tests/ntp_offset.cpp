@@ -0,0 +1,66 @@
+/*
+ * ntp_session must handle offsets of decades, like a console whose clock reset to 2000.
+ */
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+
+#include <coreinit/time.h>
+
+#include "ntp_session.hpp"
+
+#include "check.hpp"
+#include "host.hpp"
+#include "servers.hpp"
+
+
+using namespace std::literals;
+
+
+namespace {
+
+    constexpr std::int64_t years_35 = 35LL * 365 * 24 * 60 * 60;
+
+
+    // Returns the offset measured against a server `server_secs` since 2000.
+    std::optional<double>
+    measure(std::int64_t local_secs,
+            std::int64_t server_secs)
+    {
+        host::utc_offset_ticks = local_secs * OSTimerClockSpeed;
+        servers::ntp_server server{server_secs};
+
+        net::reactor reactor;
+        ntp_session session;
+        session.add(server.addr);
+        auto responses = *reactor.run({}, session.run(reactor, 2s));
+
+        if (responses.size() != 1 || !responses[0].result) {
+            if (!responses.empty() && !responses[0].result)
+                std::fprintf(stderr, "error: %s\n", responses[0].result.error().c_str());
+            return {};
+        }
+        return responses[0].result->offset().count();
+    }
+
+} // namespace
+
+
+int
+main()
+{
+    // Sanity check, no offset.
+    auto zero = measure(years_35 / 2, years_35 / 2);
+    CHECK(zero && std::abs(*zero) < 0.5);
+
+    // Clock reset to 2000, server in 2035.
+    auto ahead = measure(0, years_35);
+    CHECK(ahead && std::abs(*ahead - years_35) < 0.5);
+
+    // Clock in 2035, server in 2000.
+    auto behind = measure(years_35, 0);
+    CHECK(behind && std::abs(*behind + years_35) < 0.5);
+
+    return check_result("ntp_offset");
+}
@@ -0,0 +1,103 @@
+/*
+ * ntp_session rejects replies that can't be used, stops a burst after a kiss-o'-death,
+ * and only ends early on a quorum that outvotes the other servers.
+ */
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "ntp_session.hpp"
+
+#include "check.hpp"
+#include "servers.hpp"
+
+
+using namespace std::literals;
+
+
+namespace {
+
+    std::vector<ntp_session::response>
+    query(const servers::ntp_server& server,
+          unsigned burst)
+    {
+        net::reactor reactor;
+        ntp_session session{50ms};
+        session.add(server.addr, burst);
+        return *reactor.run({}, session.run(reactor, 500ms));
+    }
+
+
+    void
+    good()
+    {
+        servers::ntp_server server;
+        auto responses = query(server, 3);
+        CHECK(responses.size() == 1 && responses[0].result);
+        CHECK(server.requests == 3);
+    }
+
+
+    void
+    kiss_of_death()
+    {
+        servers::ntp_server server{0, 0};
+        auto responses = query(server, 3);
+        CHECK(responses.size() == 1 && !responses[0].result);
+        if (responses.size() == 1 && !responses[0].result)
+            CHECK(responses[0].result.error().find("RATE") != std::string::npos);
+        // The rest of the burst was not sent.
+        CHECK(server.requests == 1);
+    }
+
+
+    void
+    unsynchronized()
+    {
+        servers::ntp_server server{0, 16};
+        auto responses = query(server, 1);
+        CHECK(responses.size() == 1 && !responses[0].result);
+    }
+
+
+    /*
+     * Two servers that disagree with everyone reply first, then two that agree: a quorum
+     * of 2, but not a majority. The session must wait for the fifth server, or select()
+     * fails.
+     */
+    void
+    quorum_majority()
+    {
+        servers::ntp_server ahead{100};
+        servers::ntp_server behind{-100};
+        servers::ntp_server good1{0, 1, 20ms};
+        servers::ntp_server good2{0, 1, 20ms};
+        servers::ntp_server good3{0, 1, 80ms};
+
+        net::reactor reactor;
+        ntp_session session{50ms};
+        for (auto* s : { &ahead, &behind, &good1, &good2, &good3 })
+            session.add(s->addr, 1);
+        auto responses = *reactor.run({}, session.run(reactor, 500ms, 2));
+
+        std::vector<ntp::clock_filter> filters;
+        for (const auto& r : responses)
+            if (r.result)
+                filters.push_back(*r.result);
+        CHECK(ntp::has_majority(filters));
+        CHECK(good3.requests == 1);
+    }
+
+} // namespace
+
+
+int
+main()
+{
+    good();
+    kiss_of_death();
+    unsynchronized();
+    quorum_majority();
+    return check_result("ntp_replies");
+}
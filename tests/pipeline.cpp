@@ -0,0 +1,138 @@
+/*
+ * The DNS→NTP pipeline: an open ntp_session keeps running while resolve_stage() resolves
+ * names and feeds each address as soon as it's answered, and ends once the stage closes
+ * it.
+ *
+ * host::dns_server is zero, so every name goes to the getaddrinfo() fallback on the pool.
+ */
+
+#include <algorithm>            // ranges::any_of()
+#include <chrono>
+#include <latch>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "pipeline.hpp"
+
+#include "check.hpp"
+#include "host.hpp"
+#include "servers.hpp"
+
+
+using namespace std::literals;
+
+using clock_type = net::reactor::clock;
+
+
+namespace {
+
+    const net::addrinfo::hints opts{ .type = net::socket::type::udp };
+
+
+    std::vector<ntp_session::response>
+    run_pipeline(thread_pool& pool,
+                 std::vector<std::string> names,
+                 const std::string& service,
+                 std::chrono::milliseconds timeout)
+    {
+        net::reactor reactor;
+        auto pipe = std::make_shared<pipeline>(1);
+        pipe->session.open();
+        ++pipe->feeders;
+
+        auto root = [&]() -> coro::task<std::vector<ntp_session::response>>
+        {
+            reactor.spawn(resolve_stage(reactor, pipe, std::move(names), service, opts,
+                                        timeout, pool, false));
+            co_return co_await pipe->session.run(reactor, 2s);
+        };
+        return *reactor.run({}, root());
+    }
+
+
+    bool
+    notified(const std::string& text)
+    {
+        return std::ranges::any_of(host::notifications,
+                                   [&](const std::string& n)
+                                   {
+                                       return n.find(text) != std::string::npos;
+                                   });
+    }
+
+
+    void
+    feeds_while_running()
+    {
+        servers::ntp_server ntp;
+        thread_pool pool{2};
+
+        auto responses = run_pipeline(pool, {"localhost"}, std::to_string(ntp.addr.port),
+                                      1s);
+
+        // The session waited for the fallback lookup, instead of finishing with no servers.
+        CHECK(!responses.empty());
+        CHECK(std::ranges::any_of(responses,
+                                  [&](const ntp_session::response& r)
+                                  {
+                                      return r.address == ntp.addr && r.result;
+                                  }));
+        pool.release_workers();
+    }
+
+
+    // With the only worker busy, the fallback can't run; the stage gives up at the timeout.
+    void
+    bounded_fallback()
+    {
+        thread_pool pool{1};
+        std::latch release{1};
+        std::latch busy{1};
+        pool.submit([&] { busy.count_down(); release.wait(); });
+        busy.wait();
+
+        host::notifications.clear();
+        auto start = clock_type::now();
+        auto responses = run_pipeline(pool, {"localhost"}, "123", 200ms);
+        auto elapsed = clock_type::now() - start;
+
+        CHECK(responses.empty());
+        CHECK(elapsed >= 200ms);
+        CHECK(elapsed < 1s);
+        CHECK(notified("localhost: DNS lookup timed out."));
+
+        release.count_down();
+        pool.release_workers();
+    }
+
+
+    void
+    nothing_resolved()
+    {
+        thread_pool pool{1};
+
+        host::notifications.clear();
+        auto start = clock_type::now();
+        auto responses = run_pipeline(pool, {"missing.invalid"}, "123", 1s);
+        auto elapsed = clock_type::now() - start;
+
+        // close() ends it right away, without waiting for the session timeout.
+        CHECK(responses.empty());
+        CHECK(elapsed < 2s);
+        CHECK(!host::notifications.empty());
+        pool.release_workers();
+    }
+
+} // namespace
+
+
+int
+main()
+{
+    feeds_while_running();
+    bounded_fallback();
+    nothing_resolved();
+    task_state_pools::drain_all();
+    return check_result("pipeline");
+}
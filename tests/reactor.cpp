@@ -0,0 +1,221 @@
+/*
+ * net::reactor: coroutines waiting on sockets and timers share one thread, deadlines
+ * are honored, a stop request ends the loop promptly, and a net::notifier wakes it up
+ * from another thread.
+ */
+
+#include <chrono>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>              // move()
+
+#include <netinet/in.h>
+
+#include "net/notifier.hpp"
+#include "net/reactor.hpp"
+
+#include "check.hpp"
+
+
+using namespace std::literals;
+
+using clock_type = net::reactor::clock;
+
+
+namespace {
+
+    net::socket
+    make_bound()
+    {
+        net::socket s{net::socket::type::udp};
+        s.bind({INADDR_LOOPBACK, 0});
+        return s;
+    }
+
+
+    coro::task<void>
+    echo(net::reactor& reactor,
+         net::socket& s)
+    {
+        char buf[64];
+        auto got = co_await reactor.recvfrom(s, buf, sizeof buf, clock_type::now() + 2s);
+        if (got)
+            co_await reactor.sendto(s, buf, got->first, got->second, clock_type::now() + 1s);
+    }
+
+
+    coro::task<void>
+    nap(net::reactor& reactor,
+        bool& woke)
+    {
+        co_await reactor.sleep_until(clock_type::now() + 50ms);
+        woke = true;
+    }
+
+
+    // A spawned echo server and a timer run while the root task talks to the server.
+    void
+    concurrent()
+    {
+        net::reactor reactor;
+        net::socket server = make_bound();
+        net::socket client = make_bound();
+        bool woke = false;
+
+        auto root = [&]() -> coro::task<std::string>
+        {
+            reactor.spawn(echo(reactor, server));
+            reactor.spawn(nap(reactor, woke));
+            co_await reactor.sendto(client, "hello", 5, server.getsockname(),
+                                    clock_type::now() + 1s);
+            char buf[64];
+            auto back = co_await reactor.recvfrom(client, buf, sizeof buf,
+                                                  clock_type::now() + 1s);
+            co_await reactor.sleep_until(clock_type::now() + 100ms);
+            if (!back)
+                co_return "";
+            CHECK(back->second == server.getsockname());
+            co_return std::string(buf, back->first);
+        };
+
+        auto result = reactor.run({}, root());
+        CHECK(result && *result == "hello");
+        CHECK(woke);
+    }
+
+
+    // Nothing arrives: recvfrom() returns nothing once the deadline is reached.
+    void
+    deadline()
+    {
+        net::reactor reactor;
+        net::socket s = make_bound();
+
+        auto root = [&]() -> coro::task<bool>
+        {
+            char buf[4];
+            auto got = co_await reactor.recvfrom(s, buf, sizeof buf,
+                                                 clock_type::now() + 50ms);
+            co_return got.has_value();
+        };
+
+        auto start = clock_type::now();
+        auto result = reactor.run({}, root());
+        auto elapsed = clock_type::now() - start;
+        CHECK(result && !*result);
+        CHECK(elapsed >= 50ms && elapsed < 1s);
+    }
+
+
+    void
+    errors()
+    {
+        net::reactor reactor;
+        auto root = [&]() -> coro::task<int>
+        {
+            co_await reactor.sleep_until(clock_type::now() + 1ms);
+            throw std::runtime_error{"boom"};
+        };
+        try {
+            reactor.run({}, root());
+            CHECK(false);
+        }
+        catch (std::runtime_error& e) {
+            CHECK(std::strcmp(e.what(), "boom") == 0);
+        }
+    }
+
+
+    // Returns true if the task was canceled soon after a stop was requested.
+    bool
+    stopped_promptly(net::reactor& reactor,
+                     coro::task<int> task)
+    {
+        std::stop_source source;
+        std::jthread stopper{[&]
+        {
+            std::this_thread::sleep_for(30ms);
+            source.request_stop();
+        }};
+        auto start = clock_type::now();
+        auto result = reactor.run(source.get_token(), std::move(task));
+        auto elapsed = clock_type::now() - start;
+        return !result && elapsed < 30ms + 2 * net::reactor::max_wait;
+    }
+
+
+    // A stop request ends both timer waits and socket waits, without waiting them out.
+    void
+    cancellation()
+    {
+        net::reactor reactor;
+        net::socket s = make_bound();
+
+        auto sleeper = [&]() -> coro::task<int>
+        {
+            co_await reactor.sleep_until(clock_type::now() + 10s);
+            co_return 1;
+        };
+        auto reader = [&]() -> coro::task<int>
+        {
+            char buf[4];
+            co_await reactor.recvfrom(s, buf, sizeof buf, clock_type::now() + 10s);
+            co_return 1;
+        };
+
+        std::stop_source stopped;
+        stopped.request_stop();
+        CHECK(!reactor.run(stopped.get_token(), sleeper()));
+
+        CHECK(stopped_promptly(reactor, sleeper()));
+        CHECK(stopped_promptly(reactor, reader()));
+    }
+
+
+    // Another thread's notify() ends the wait long before the deadline; without it, the
+    // wait times out.
+    void
+    notified()
+    {
+        net::reactor reactor;
+        net::notifier n;
+
+        auto root = [&]() -> coro::task<bool>
+        {
+            co_return co_await n.wait(reactor, clock_type::now() + 5s);
+        };
+
+        auto start = clock_type::now();
+        std::jthread other{[&] { std::this_thread::sleep_for(20ms); n.notify(); }};
+        auto result = reactor.run({}, root());
+        CHECK(result && *result);
+        CHECK(clock_type::now() - start < 1s);
+
+        // A notification that came before the wait is not lost, and only counts once.
+        n.notify();
+        n.notify();
+        result = reactor.run({}, root());
+        CHECK(result && *result);
+        auto quiet = [&]() -> coro::task<bool>
+        {
+            co_return co_await n.wait(reactor, clock_type::now() + 50ms);
+        };
+        result = reactor.run({}, quiet());
+        CHECK(result && !*result);
+    }
+
+} // namespace
+
+
+int
+main()
+{
+    concurrent();
+    deadline();
+    errors();
+    cancellation();
+    notified();
+    return check_result("reactor");
+}
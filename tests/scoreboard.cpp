@@ -0,0 +1,80 @@
+/*
+ * scoreboard: the round-trip deviation follows the delays, not the offsets, and survives
+ * storage, including entries stored before it existed.
+ */
+
+#include <cmath>
+
+#include "scoreboard.hpp"
+
+#include "check.hpp"
+#include "host.hpp"
+
+
+namespace {
+
+    using ntp::dbl_seconds;
+
+
+    // A filter whose best sample has this delay; the offsets are far apart.
+    ntp::clock_filter
+    make_filter(double delay)
+    {
+        ntp::clock_filter f;
+        f.add({ dbl_seconds{0.5}, dbl_seconds{delay}, dbl_seconds{0}, dbl_seconds{0}, 2 });
+        f.add({ dbl_seconds{-0.5}, dbl_seconds{delay + 1}, dbl_seconds{0}, dbl_seconds{1}, 2 });
+        return f;
+    }
+
+
+    bool
+    near(double a,
+         double b)
+    {
+        return std::abs(a - b) < 1e-9;
+    }
+
+
+    void
+    deviation()
+    {
+        net::address addr{0x0a000001, 123};
+
+        scoreboard::success(addr, make_filter(0.1));
+        auto s = scoreboard::find(addr);
+        CHECK(s && near(s->rtt, 0.1) && near(s->rttvar, 0.05));
+
+        // RFC 6298: rttvar = 3/4 rttvar + 1/4 |srtt - r|, then srtt = 3/4 srtt + 1/4 r.
+        scoreboard::success(addr, make_filter(0.3));
+        s = scoreboard::find(addr);
+        CHECK(s && near(s->rttvar, 0.75 * 0.05 + 0.25 * 0.2));
+        CHECK(s && near(s->rtt, 0.75 * 0.1 + 0.25 * 0.3));
+        // The offsets were a second apart; that's jitter, not round-trip deviation.
+        CHECK(s && s->rttvar < 0.1);
+
+        scoreboard::store();
+        scoreboard::load();
+        auto loaded = scoreboard::find(addr);
+        CHECK(loaded && near(loaded->rttvar, s->rttvar));
+    }
+
+
+    void
+    old_format()
+    {
+        host::storage["scoreboard"] = "167772162 123 0.9 0.2 0.01 2 0 0 100\n";
+        scoreboard::load();
+        auto s = scoreboard::find({0x0a000002, 123});
+        CHECK(s && near(s->rtt, 0.2) && near(s->rttvar, 0.1));
+    }
+
+} // namespace
+
+
+int
+main()
+{
+    deviation();
+    old_format();
+    return check_result("scoreboard");
+}
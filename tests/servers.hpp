@@ -0,0 +1,335 @@
+#ifndef SERVERS_HPP
+#define SERVERS_HPP
+
+/*
+ * Stand-in NTP and DNS servers on the loopback interface, each running in its own thread.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <coreinit/time.h>
+
+#include "net/address.hpp"
+#include "ntp.hpp"
+
+
+namespace servers {
+
+    // A bound loopback UDP socket, whose reads time out quickly so its thread can stop.
+    class udp_server {
+
+    protected:
+
+        int fd;
+        std::jthread thread;
+
+    public:
+
+        net::address addr;
+
+
+        udp_server()
+        {
+            fd = socket(AF_INET, SOCK_DGRAM, 0);
+            sockaddr_in sa{};
+            sa.sin_family = AF_INET;
+            sa.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+            bind(fd, reinterpret_cast<sockaddr*>(&sa), sizeof sa);
+            socklen_t sa_size = sizeof sa;
+            getsockname(fd, reinterpret_cast<sockaddr*>(&sa), &sa_size);
+            addr = {INADDR_LOOPBACK, ntohs(sa.sin_port)};
+            timeval tv{0, 10'000};
+            setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof tv);
+        }
+
+
+        ~udp_server()
+        {
+            stop();
+            close(fd);
+        }
+
+    protected:
+
+        // Note: derived classes whose handler uses their members must call it first.
+        void
+        stop()
+        {
+            thread = {};
+        }
+
+
+        // Call handle() for every datagram received, until stopped.
+        template<typename Handler>
+        void
+        start(Handler handle)
+        {
+            thread = std::jthread{[this, handle](std::stop_token token)
+            {
+                while (!token.stop_requested()) {
+                    std::uint8_t buf[512];
+                    sockaddr_in src{};
+                    socklen_t src_size = sizeof src;
+                    auto n = recvfrom(fd, buf, sizeof buf, 0,
+                                      reinterpret_cast<sockaddr*>(&src), &src_size);
+                    if (n > 0)
+                        handle(buf, static_cast<std::size_t>(n), src);
+                }
+            }};
+        }
+
+
+        void
+        reply(const void* msg,
+              std::size_t size,
+              const sockaddr_in& dst)
+        {
+            sendto(fd, msg, size, 0, reinterpret_cast<const sockaddr*>(&dst), sizeof dst);
+        }
+
+    };
+
+
+    // Seconds from the NTP epoch (1900) to the Wii U epoch (2000).
+    constexpr std::int64_t epoch_diff = 24LL * 60 * 60 * (100 * 365 + 24);
+
+
+    /*
+     * An NTP server whose clock is `server_secs` seconds since 2000, plus the uptime. A
+     * stratum of zero makes it answer with kiss-o'-death "RATE" packets.
+     */
+    class ntp_server : public udp_server {
+
+    public:
+
+        std::atomic<unsigned> requests = 0;
+
+
+        // Replies are sent `delay` after the request arrives.
+        explicit
+        ntp_server(std::int64_t server_secs = 0,
+                   std::uint8_t stratum = 1,
+                   std::chrono::milliseconds delay = {})
+        {
+            start([this, server_secs, stratum, delay](const std::uint8_t* data,
+                                                      std::size_t size,
+                                                      const sockaddr_in& src)
+            {
+                ntp::packet p;
+                if (size != sizeof p)
+                    return;
+                ++requests;
+                std::this_thread::sleep_for(delay);
+                std::memcpy(&p, data, sizeof p);
+                double now = static_cast<double>(OSGetSystemTime()) / OSTimerClockSpeed;
+                ntp::timestamp t{ntp::dbl_seconds{now + server_secs + epoch_diff}};
+                p.origin_time = p.transmit_time;
+                p.receive_time = t;
+                p.transmit_time = t;
+                p.version(4);
+                p.mode(ntp::packet::mode_flag::server);
+                p.stratum = stratum;
+                if (!stratum)
+                    std::memcpy(p.reference_id, "RATE", 4);
+                reply(&p, sizeof p, src);
+            });
+        }
+
+
+        ~ntp_server()
+        {
+            stop();
+        }
+
+    };
+
+
+    // Addresses in the DNS server's answers.
+    constexpr std::uint32_t ip_a1 = 0x0a000001; // 10.0.0.1
+    constexpr std::uint32_t ip_a2 = 0x0a000002;
+    constexpr std::uint32_t ip_good = 0x0a000003;
+    constexpr std::uint32_t ip_evil = 0x06060606;
+
+
+    inline
+    void
+    put16(std::vector<std::uint8_t>& out,
+          std::uint16_t v)
+    {
+        out.push_back(v >> 8);
+        out.push_back(v & 0xff);
+    }
+
+
+    inline
+    void
+    put32(std::vector<std::uint8_t>& out,
+          std::uint32_t v)
+    {
+        put16(out, v >> 16);
+        put16(out, v & 0xffff);
+    }
+
+
+    inline
+    std::vector<std::uint8_t>
+    encode_name(const std::string& name)
+    {
+        std::vector<std::uint8_t> out;
+        std::size_t start = 0;
+        while (start < name.size()) {
+            auto dot = name.find('.', start);
+            if (dot == std::string::npos)
+                dot = name.size();
+            out.push_back(dot - start);
+            out.insert(out.end(), name.begin() + start, name.begin() + dot);
+            start = dot + 1;
+        }
+        out.push_back(0);
+        return out;
+    }
+
+
+    struct a_record {
+        std::uint32_t ip;
+        std::uint32_t ttl;
+    };
+
+
+    inline
+    std::vector<std::uint8_t>
+    make_reply(std::uint16_t id,
+               const std::string& qname,
+               std::uint8_t rcode,
+               const std::vector<a_record>& records)
+    {
+        std::vector<std::uint8_t> out;
+        put16(out, id);
+        put16(out, 0x8180 | rcode); // response, recursion desired and available
+        put16(out, 1);
+        put16(out, records.size());
+        put16(out, 0);
+        put16(out, 0);
+        auto name = encode_name(qname);
+        out.insert(out.end(), name.begin(), name.end());
+        put16(out, 1); // A
+        put16(out, 1); // IN
+        for (auto [ip, ttl] : records) {
+            put16(out, 0xc00c); // pointer to the question's name
+            put16(out, 1);
+            put16(out, 1);
+            put32(out, ttl);
+            put16(out, 4);
+            put32(out, ip);
+        }
+        return out;
+    }
+
+
+    /*
+     * A DNS server with canned answers:
+     *     a.test        two addresses, with different TTLs
+     *     missing.test  NXDOMAIN
+     *     spoofed.test  forged replies first, then the real one
+     *     lossy.test    the first query is lost
+     *     loopback.test 127.0.0.1
+     */
+    class dns_server : public udp_server {
+
+        std::mutex mutex;
+        std::vector<std::uint16_t> ids;
+        unsigned lossy_queries = 0;
+
+        void
+        reply(const std::vector<std::uint8_t>& msg,
+              const sockaddr_in& dst)
+        {
+            udp_server::reply(msg.data(), msg.size(), dst);
+        }
+
+
+        void
+        handle(const std::uint8_t* data,
+               std::size_t size,
+               const sockaddr_in& src)
+        {
+            if (size < 12)
+                return;
+            std::uint16_t id = (data[0] << 8) | data[1];
+            std::string name;
+            for (std::size_t pos = 12; pos < size && data[pos]; pos += 1 + data[pos]) {
+                if (!name.empty())
+                    name += '.';
+                name.append(reinterpret_cast<const char*>(data + pos + 1), data[pos]);
+            }
+            {
+                std::lock_guard guard{mutex};
+                ids.push_back(id);
+            }
+
+            if (name == "a.test")
+                reply(make_reply(id, name, 0, {{ip_a1, 300}, {ip_a2, 60}}), src);
+            else if (name == "missing.test")
+                reply(make_reply(id, name, 3, {}), src);
+            else if (name == "spoofed.test") {
+                // Wrong ID, then right ID with a different question; both must be ignored.
+                reply(make_reply(id ^ 0x5555, name, 0, {{ip_evil, 60}}), src);
+                reply(make_reply(id, "evil.test", 0, {{ip_evil, 60}}), src);
+                // The real answer echoes the question with a different case.
+                std::string upper = name;
+                std::ranges::transform(upper, upper.begin(), ::toupper);
+                reply(make_reply(id, upper, 0, {{ip_good, 60}}), src);
+            } else if (name == "lossy.test") {
+                std::lock_guard guard{mutex};
+                if (lossy_queries++ == 0)
+                    return; // the first query is lost
+                reply(make_reply(id, name, 0, {{ip_good, 60}}), src);
+            } else if (name == "loopback.test")
+                reply(make_reply(id, name, 0, {{INADDR_LOOPBACK, 60}}), src);
+        }
+
+    public:
+
+        dns_server()
+        {
+            start([this](const std::uint8_t* data,
+                         std::size_t size,
+                         const sockaddr_in& src)
+            {
+                handle(data, size, src);
+            });
+        }
+
+
+        ~dns_server()
+        {
+            stop();
+        }
+
+
+        std::vector<std::uint16_t>
+        seen_ids()
+        {
+            std::lock_guard guard{mutex};
+            return ids;
+        }
+
+    };
+
+} // namespace servers
+
+#endif
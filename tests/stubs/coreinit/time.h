@@ -0,0 +1,11 @@
+#pragma once
+// Host stand-in for <coreinit/time.h>.
+#include <cstdint>
+
+typedef std::int64_t OSTime;
+typedef std::int64_t OSTick;
+
+#define OSTimerClockSpeed 62156250
+
+OSTime OSGetTime();
+OSTime OSGetSystemTime();
@@ -0,0 +1,250 @@
+/*
+ * Host implementations of the console functions used by the code under test.
+ */
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdarg>
+#include <cstdio>
+#include <map>
+#include <mutex>
+#include <stop_token>
+#include <string>
+#include <vector>
+
+#include <coreinit/time.h>
+#include <nn/ac.h>
+#include <wupsxx/logger.hpp>
+#include <wupsxx/storage.hpp>
+
+#include "core.hpp"
+#include "notify.hpp"
+#include "utc.hpp"
+
+#include "host.hpp"
+
+
+namespace host {
+
+    std::int64_t utc_offset_ticks = 0;
+
+    std::uint32_t dns_server = 0;
+
+    std::map<std::string, std::string> storage;
+
+    unsigned saves = 0;
+
+    bool verbose = false;
+
+    std::vector<std::string> notifications;
+
+}
+
+
+OSTime
+OSGetSystemTime()
+{
+    auto ns = std::chrono::steady_clock::now().time_since_epoch().count();
+    // Note: split in seconds, so the multiplication can't overflow.
+    return (ns / 1'000'000'000) * OSTimerClockSpeed
+        + (ns % 1'000'000'000) * OSTimerClockSpeed / 1'000'000'000;
+}
+
+
+OSTime
+OSGetTime()
+{
+    return OSGetSystemTime() + host::utc_offset_ticks;
+}
+
+
+int
+WHBLogPrintf(const char* fmt, ...)
+{
+    if (!host::verbose)
+        return 0;
+    std::va_list args;
+    va_start(args, fmt);
+    int r = std::vfprintf(stderr, fmt, args);
+    va_end(args);
+    std::fputc('\n', stderr);
+    return r;
+}
+
+
+NNResult
+ACGetAssignedPrimaryDns(std::uint32_t* ip)
+{
+    *ip = host::dns_server;
+    return { host::dns_server ? 0 : -1 };
+}
+
+
+NNResult
+ACGetAssignedSecondaryDns(std::uint32_t* ip)
+{
+    *ip = 0;
+    return { -1 };
+}
+
+
+namespace wups {
+
+    namespace logger {
+
+        void
+        printf(const char* fmt, ...)
+        {
+            if (!host::verbose)
+                return;
+            std::va_list args;
+            va_start(args, fmt);
+            std::vfprintf(stderr, fmt, args);
+            va_end(args);
+        }
+
+        guard::guard() {}
+
+        guard::~guard() {}
+
+    } // namespace logger
+
+
+    template<>
+    bool
+    load(const std::string& key, std::string& value)
+    {
+        auto it = host::storage.find(key);
+        if (it == host::storage.end())
+            return false;
+        value = it->second;
+        return true;
+    }
+
+
+    template<>
+    void
+    store(const std::string& key, const std::string& value)
+    {
+        host::storage[key] = value;
+    }
+
+
+    void
+    save()
+    {
+        ++host::saves;
+    }
+
+} // namespace wups
+
+
+namespace utils {
+
+    bool
+    wait_until(std::stop_token token,
+               std::chrono::steady_clock::time_point deadline)
+    {
+        static std::mutex mutex;
+        static std::condition_variable_any cond;
+        std::unique_lock lock{mutex};
+        cond.wait_until(lock, token, deadline, [] { return false; });
+        return !token.stop_requested();
+    }
+
+} // namespace utils
+
+
+namespace utc {
+
+    timestamp
+    now()
+        noexcept
+    {
+        double t = static_cast<double>(OSGetTime()) / OSTimerClockSpeed;
+        return timestamp{ dbl_seconds{t} };
+    }
+
+
+    std::int64_t
+    system_ticks_offset()
+        noexcept
+    {
+        return host::utc_offset_ticks;
+    }
+
+
+    clock_anchor
+    make_anchor(std::int64_t system_ticks)
+        noexcept
+    {
+        return { system_ticks, system_ticks + host::utc_offset_ticks };
+    }
+
+} // namespace utc
+
+
+namespace notify {
+
+    namespace {
+
+        std::mutex mutex;
+
+
+        void
+        record(const char* fmt,
+               std::va_list args)
+        {
+            char buf[512];
+            std::vsnprintf(buf, sizeof buf, fmt, args);
+            std::lock_guard guard{mutex};
+            host::notifications.push_back(buf);
+            if (host::verbose)
+                std::fprintf(stderr, "notify: %s\n", buf);
+        }
+
+    } // namespace
+
+
+    void
+    error(level, const char* fmt, ...)
+        noexcept
+    {
+        std::va_list args;
+        va_start(args, fmt);
+        record(fmt, args);
+        va_end(args);
+    }
+
+
+    void
+    info(level, const char* fmt, ...)
+        noexcept
+    {
+        std::va_list args;
+        va_start(args, fmt);
+        record(fmt, args);
+        va_end(args);
+    }
+
+
+    void
+    success(level, const char* fmt, ...)
+        noexcept
+    {
+        std::va_list args;
+        va_start(args, fmt);
+        record(fmt, args);
+        va_end(args);
+    }
+
+} // namespace notify
+
+
+namespace core {
+
+    canceled_error::canceled_error() :
+        runtime_error{"Operation canceled."}
+    {}
+
+} // namespace core
@@ -0,0 +1,19 @@
+#pragma once
+// Forced into every host test translation unit, for what the Wii U headers add on top of
+// the POSIX ones.
+#include <sys/socket.h>
+
+#define SO_BIO          0x1001
+#define SO_HOPCNT       0x1002
+#define SO_MAXMSG       0x1003
+#define SO_MYADDR       0x1004
+#define SO_NBIO         0x1005
+#define SO_NONBLOCK     0x1006
+#define SO_NOSLOWSTART  0x1007
+#define SO_RUSRBUF      0x1008
+#define SO_RXDATA       0x1009
+#define SO_TCPSACK      0x100a
+#define SO_TXDATA       0x100b
+#define SO_WINSCALE     0x100c
+#define TCP_ACKDELAYTIME 0x2001
+#define TCP_NOACKDELAY   0x2002
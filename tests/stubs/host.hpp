@@ -0,0 +1,26 @@
+#pragma once
+// Knobs for the host implementations in host.cpp.
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace host {
+
+    // What utc::system_ticks_offset() returns; zero means the clock is at 2000-01-01.
+    extern std::int64_t utc_offset_ticks;
+
+    // What ACGetAssignedPrimaryDns() reports, in host byte order; zero means none.
+    extern std::uint32_t dns_server;
+
+    // What wups::store() wrote, and how many times wups::save() was called.
+    extern std::map<std::string, std::string> storage;
+    extern unsigned saves;
+
+    // Print the log messages to stderr.
+    extern bool verbose;
+
+    // Every message passed to notify::error(), info() and success().
+    extern std::vector<std::string> notifications;
+
+}
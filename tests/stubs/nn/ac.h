@@ -0,0 +1,10 @@
+#pragma once
+// Host stand-in for <nn/ac.h>.
+#include <cstdint>
+
+typedef struct { std::int32_t value; } NNResult;
+
+inline bool NNResult_IsSuccess(NNResult r) { return r.value >= 0; }
+
+NNResult ACGetAssignedPrimaryDns(std::uint32_t* ip);
+NNResult ACGetAssignedSecondaryDns(std::uint32_t* ip);
@@ -0,0 +1,3 @@
+#pragma once
+// Host stand-in for <sys/endian.h>.
+#include <endian.h>
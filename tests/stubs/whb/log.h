@@ -0,0 +1,3 @@
+#pragma once
+// Host stand-in for <whb/log.h>.
+int WHBLogPrintf(const char* fmt, ...);
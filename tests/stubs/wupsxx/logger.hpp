@@ -0,0 +1,12 @@
+#pragma once
+// Host stand-in for <wupsxx/logger.hpp>.
+namespace wups::logger {
+
+    void printf(const char* fmt, ...);
+
+    struct guard {
+        guard();
+        ~guard();
+    };
+
+}
@@ -0,0 +1,15 @@
+#pragma once
+// Host stand-in for <wupsxx/storage.hpp>; only strings are stored, in memory.
+#include <string>
+
+namespace wups {
+
+    template<typename T>
+    bool load(const std::string& key, T& value);
+
+    template<typename T>
+    void store(const std::string& key, const T& value);
+
+    void save();
+
+}
@@ -0,0 +1,116 @@
+/*
+ * thread_pool::submit() must not allocate in steady state: once the task_state free lists
+ * and the deques are warm, submitting small tasks, from outside the pool and from a
+ * worker, allocates nothing.
+ *
+ * The global operator new is replaced by a counting one, so this test is built without
+ * sanitizers.
+ */
+
+#include <atomic>
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+#include <vector>
+
+#include "thread_pool.hpp"
+
+#include "check.hpp"
+
+
+namespace {
+
+    std::atomic<std::size_t> allocations = 0;
+
+
+    void*
+    counted(std::size_t size,
+            std::size_t align = 0)
+    {
+        ++allocations;
+        void* p = align > alignof(std::max_align_t)
+            ? std::aligned_alloc(align, (size + align - 1) / align * align)
+            : std::malloc(size ? size : 1);
+        if (!p)
+            throw std::bad_alloc{};
+        return p;
+    }
+
+} // namespace
+
+
+void* operator new(std::size_t size) { return counted(size); }
+void* operator new[](std::size_t size) { return counted(size); }
+void* operator new(std::size_t size, std::align_val_t a) { return counted(size, std::size_t(a)); }
+void* operator new[](std::size_t size, std::align_val_t a) { return counted(size, std::size_t(a)); }
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::size_t) noexcept { std::free(p); }
+void operator delete(void* p, std::align_val_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::align_val_t) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t, std::align_val_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::size_t, std::align_val_t) noexcept { std::free(p); }
+
+
+namespace {
+
+    constexpr int batch = 256;
+    constexpr int inner = 8;
+
+
+    // One round: small tasks from outside, and tasks that submit more from a worker.
+    void
+    round(thread_pool& pool,
+          std::vector<task_future<int>>& futures,
+          std::vector<task_future<int>>& nested)
+    {
+        futures.clear();
+        for (int i = 0; i < batch; ++i)
+            futures.push_back(pool.submit([](int x) { return x + 1; }, i));
+        for (int i = 0; i < batch; ++i)
+            CHECK(futures[i].get() == i + 1);
+
+        futures.clear();
+        for (int i = 0; i < batch / inner; ++i)
+            futures.push_back(pool.submit([&pool, &nested, i]
+            {
+                // Each outer task has its own slice of `nested`.
+                int sum = 0;
+                for (int j = 0; j < inner; ++j)
+                    nested[i * inner + j] = pool.submit([j] { return j; });
+                for (int j = 0; j < inner; ++j)
+                    sum += pool.get(nested[i * inner + j]);
+                return sum;
+            }));
+        for (auto& f : futures)
+            CHECK(f.get() == inner * (inner - 1) / 2);
+    }
+
+} // namespace
+
+
+int
+main()
+{
+    {
+        thread_pool pool{4};
+        std::vector<task_future<int>> futures;
+        futures.reserve(batch);
+        std::vector<task_future<int>> nested(batch);
+
+        // Warm up: start the workers, fill the free lists, and grow the deques.
+        for (int r = 0; r < 20; ++r)
+            round(pool, futures, nested);
+
+        allocations = 0;
+        for (int r = 0; r < 20; ++r)
+            round(pool, futures, nested);
+        CHECK(allocations == 0);
+
+        pool.release_workers();
+    }
+    task_state_pools::drain_all();
+    return check_result("task_alloc");
+}
@@ -0,0 +1,144 @@
+/*
+ * thread_pool: tasks submitted from outside and from inside the pool all run once, their
+ * results and errors reach the futures, and recycled task states are neither leaked nor
+ * used after being freed. Meant to run under the address sanitizer.
+ */
+
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "thread_pool.hpp"
+
+#include "check.hpp"
+
+
+using namespace std::literals;
+
+
+namespace {
+
+    void
+    results()
+    {
+        thread_pool pool{4};
+
+        std::vector<task_future<std::string>> futures;
+        for (int i = 0; i < 1000; ++i)
+            futures.push_back(pool.submit([](int x) { return std::to_string(x); }, i));
+        for (int i = 0; i < 1000; ++i)
+            CHECK(futures[i].get() == std::to_string(i));
+
+        auto fail = pool.submit([] { throw std::runtime_error{"boom"}; });
+        try {
+            fail.get();
+            CHECK(false);
+        }
+        catch (std::runtime_error& e) {
+            CHECK(e.what() == std::string{"boom"});
+        }
+    }
+
+
+    // With one busy worker, enqueue() must leave the task for later, not run it inline.
+    void
+    enqueue()
+    {
+        thread_pool pool{1};
+
+        auto outer = pool.submit([&]
+        {
+            auto inner = pool.enqueue([] { return std::this_thread::get_id(); });
+            std::this_thread::sleep_for(10ms);
+            return std::pair{ !inner.is_ready(), std::move(inner) };
+        });
+        auto [deferred, inner] = outer.get();
+        CHECK(deferred);
+        CHECK(inner.get() != std::this_thread::get_id());
+    }
+
+
+    // A worker stuck in a task is detached after the timeout; the pool keeps working.
+    void
+    release_stuck()
+    {
+        thread_pool pool{1};
+        std::atomic<bool> started = false;
+        std::atomic<bool> unblock = false;
+
+        auto stuck = pool.submit([&]
+        {
+            started = true;
+            while (!unblock)
+                std::this_thread::sleep_for(1ms);
+        });
+        while (!started)
+            std::this_thread::sleep_for(1ms);
+
+        auto start = std::chrono::steady_clock::now();
+        CHECK(pool.release_workers(50ms) == 1);
+        CHECK(std::chrono::steady_clock::now() - start < 1s);
+
+        // A new worker takes over.
+        CHECK(pool.submit([] { return 7; }).get() == 7);
+
+        // The detached worker finishes its task, and the destructor waits for it.
+        unblock = true;
+        stuck.get();
+        CHECK(pool.release_workers(1s) == 0);
+    }
+
+
+    void
+    stress()
+    {
+        constexpr int rounds = 50;
+        constexpr int outer = 200;
+        constexpr int inner = 4;
+
+        thread_pool pool{4};
+        std::atomic<int> ran = 0;
+
+        for (int r = 0; r < rounds; ++r) {
+            std::vector<task_future<void>> futures;
+            for (int i = 0; i < outer; ++i)
+                futures.push_back(pool.submit([&]
+                {
+                    // Dropped futures: the states go back to the free list when the
+                    // tasks finish, on whichever thread runs them.
+                    for (int j = 0; j < inner; ++j)
+                        pool.submit([&] { ++ran; });
+                    ++ran;
+                }));
+            for (auto& f : futures)
+                f.get();
+            // Shrink and grow the pool while tasks may still be queued.
+            pool.resize(1 + r % 4);
+        }
+
+        // Nested tasks may still be queued; give them time to run.
+        const int expected = rounds * outer * (inner + 1);
+        auto deadline = std::chrono::steady_clock::now() + 10s;
+        while (ran < expected && std::chrono::steady_clock::now() < deadline)
+            std::this_thread::sleep_for(1ms);
+        CHECK(ran == expected);
+        pool.release_workers();
+    }
+
+} // namespace
+
+
+int
+main()
+{
+    results();
+    enqueue();
+    release_stuck();
+    stress();
+    task_state_pools::drain_all();
+    return check_result("thread_pool");
+}
@@ -0,0 +1,94 @@
+/*
+ * work_stealing_deque: every element pushed is taken or stolen exactly once, while the
+ * deque grows under contention. Meant to run under the thread sanitizer.
+ */
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "work_stealing_deque.hpp"
+
+#include "check.hpp"
+
+
+namespace {
+
+    void
+    single_thread()
+    {
+        work_stealing_deque<int> dq{2};
+        int values[5] = {0, 1, 2, 3, 4};
+        CHECK(!dq.take());
+        CHECK(!dq.steal());
+        for (auto& v : values)
+            dq.push(&v); // grows twice
+        CHECK(dq.take() == &values[4]);  // newest from the bottom
+        CHECK(dq.steal() == &values[0]); // oldest from the top
+        CHECK(dq.take() == &values[3]);
+        CHECK(dq.take() == &values[2]);
+        CHECK(dq.take() == &values[1]);
+        CHECK(!dq.take());
+        CHECK(!dq.steal());
+    }
+
+
+    void
+    contended()
+    {
+        constexpr int count = 200'000;
+        constexpr int thieves = 3;
+
+        std::vector<int> values(count);
+        std::vector<std::atomic<int>> seen(count);
+        work_stealing_deque<int> dq{4};
+        std::atomic<bool> done = false;
+
+        auto consume = [&](int* x)
+        {
+            seen[x - values.data()].fetch_add(1, std::memory_order_relaxed);
+        };
+
+        std::vector<std::jthread> threads;
+        for (int i = 0; i < thieves; ++i)
+            threads.emplace_back([&]
+            {
+                while (!done.load(std::memory_order_acquire))
+                    if (auto x = dq.steal())
+                        consume(x);
+                while (auto x = dq.steal())
+                    consume(x);
+            });
+
+        // The owner pushes in bursts, and takes some back in between.
+        for (int i = 0; i < count; ++i) {
+            dq.push(&values[i]);
+            if (i % 3 == 0)
+                if (auto x = dq.take())
+                    consume(x);
+        }
+        while (auto x = dq.take())
+            consume(x);
+        done.store(true, std::memory_order_release);
+        threads.clear();
+
+        int missing = 0;
+        int duplicated = 0;
+        for (auto& s : seen) {
+            missing += s == 0;
+            duplicated += s > 1;
+        }
+        CHECK(missing == 0);
+        CHECK(duplicated == 0);
+    }
+
+} // namespace
+
+
+int
+main()
+{
+    single_thread();
+    contended();
+    return check_result("work_stealing_deque");
+}